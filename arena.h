@@ -0,0 +1,66 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Арена строк одного пакета: байты добавляются сдвигом указателя в крупных блоках
+// и освобождаются разом вместе с ареной после отправки пакета
+class StringArena {
+public:
+    static constexpr size_t kFirstChunk = 64 * 1024;
+    static constexpr size_t kMaxChunk = 4 * 1024 * 1024;
+
+    StringArena() = default;
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    // Копия строки в арене; представление действительно, пока жива арена
+    string_view copy(string_view value) {
+        if (value.empty()) {
+            return string_view();
+        }
+        if (value.size() > left_) {
+            grow(value.size());
+        }
+        char* out = cursor_;
+        memcpy(out, value.data(), value.size());
+        cursor_ += value.size();
+        left_ -= value.size();
+        used_ += value.size();
+        return string_view(out, value.size());
+    }
+
+    // Объём сохранённых строк
+    size_t used() const {
+        return used_;
+    }
+
+    // Объём памяти, запрошенной у системы
+    size_t reserved() const {
+        return reserved_;
+    }
+
+private:
+    void grow(size_t need) {
+        size_t size = max(need, min(kMaxChunk, chunks_.empty() ? kFirstChunk : reserved_));
+        chunks_.push_back(make_unique_for_overwrite<char[]>(size));
+        cursor_ = chunks_.back().get();
+        left_ = size;
+        reserved_ += size;
+    }
+
+    vector<unique_ptr<char[]>> chunks_;
+    char* cursor_ = nullptr;
+    size_t left_ = 0;
+    size_t used_ = 0;
+    size_t reserved_ = 0;
+};
+
+#endif // ARENA_H
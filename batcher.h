@@ -0,0 +1,293 @@
+#ifndef BATCHER_H
+#define BATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "insert.h"
+#include "partition.h"
+
+using namespace std;
+
+// Пороги сброса пакета: по числу строк, объёму данных и возрасту первой строки
+struct BatchLimits {
+    size_t maxRows = 100000;
+    size_t maxBytes = 64 * 1024 * 1024;
+    chrono::milliseconds maxAge{1000};
+    // Общий объём всех партиций таблицы; при превышении сбрасывается самая крупная
+    size_t maxBufferedBytes = 256 * 1024 * 1024;
+    // Столбец DateTime64, по которому сортируются строки пакета перед вставкой; пусто — без сортировки
+    string sortColumn = "datetime";
+};
+
+using FlushFn = function<void(const string& table_name, const Block& block)>;
+
+// Построитель пакетов с разбиением по партициям: у каждой партиции своя корзина со своими порогами,
+// поэтому пакет исторической догрузки, охватывающий много дней, не порождает по части на каждый день
+class PartitionedBuilder {
+public:
+    static constexpr size_t kMaxIdleBuckets = 64;
+
+    PartitionedBuilder(const TblCol& columns, const BatchLimits& limits, PartitionKey partition = {})
+        : columns_(columns), limits_(limits), partition_(partition) {}
+
+    // Добавление строки; пакеты, достигшие порогов, переносятся в ready
+    template <typename Values>
+    void appendRow(const Values& values, vector<Batch>& ready) {
+        int64_t key = 0;
+        if (partition_.enabled() && static_cast<size_t>(partition_.column) < values.size()) {
+            key = partition_.bucket(values[partition_.column]);
+        }
+        Bucket& bucket = find(key);
+        bucket.builder->appendRow(values);
+        if (bucket.builder->rows() == 1) {
+            bucket.firstRowAt = chrono::steady_clock::now();
+        }
+        size_t bytes = 0;
+        for (const auto& value : values) {
+            bytes += value.size();
+        }
+        bucket.bytes += bytes;
+        bytes_ += bytes;
+        ++rows_;
+
+        if (bucket.builder->rows() >= limits_.maxRows || bucket.bytes >= limits_.maxBytes) {
+            ready.push_back(take(bucket));
+        } else if (bytes_ >= limits_.maxBufferedBytes) {
+            Bucket* largest = &bucket;
+            for (auto& [k, b] : buckets_) {
+                if (b.bytes > largest->bytes) {
+                    largest = &b;
+                }
+            }
+            ready.push_back(take(*largest));
+        }
+    }
+
+    size_t rows() const {
+        return rows_;
+    }
+
+    // Момент, когда самая старая корзина достигнет maxAge
+    optional<chrono::steady_clock::time_point> deadline() const {
+        optional<chrono::steady_clock::time_point> result;
+        for (const auto& [key, bucket] : buckets_) {
+            if (bucket.builder->rows() > 0 && (!result || bucket.firstRowAt + limits_.maxAge < *result)) {
+                result = bucket.firstRowAt + limits_.maxAge;
+            }
+        }
+        return result;
+    }
+
+    void takeExpired(chrono::steady_clock::time_point now, vector<Batch>& ready) {
+        for (auto& [key, bucket] : buckets_) {
+            if (bucket.builder->rows() > 0 && now >= bucket.firstRowAt + limits_.maxAge) {
+                ready.push_back(take(bucket));
+            }
+        }
+        trim();
+    }
+
+    void takeAll(vector<Batch>& ready) {
+        for (auto& [key, bucket] : buckets_) {
+            if (bucket.builder->rows() > 0) {
+                ready.push_back(take(bucket));
+            }
+        }
+        trim();
+    }
+
+private:
+    struct Bucket {
+        unique_ptr<BlockBuilder> builder;
+        size_t bytes = 0;
+        chrono::steady_clock::time_point firstRowAt;
+    };
+
+    // Соседние строки почти всегда попадают в одну партицию, поэтому последняя корзина запоминается
+    Bucket& find(int64_t key) {
+        if (last_ && lastKey_ == key) {
+            return *last_;
+        }
+        auto [it, inserted] = buckets_.try_emplace(key);
+        if (inserted) {
+            it->second.builder = make_unique<BlockBuilder>(columns_);
+            if (!limits_.sortColumn.empty()) {
+                it->second.builder->sortBy(limits_.sortColumn);
+            }
+        }
+        last_ = &it->second;
+        lastKey_ = key;
+        return *last_;
+    }
+
+    Batch take(Bucket& bucket) {
+        rows_ -= bucket.builder->rows();
+        bytes_ -= bucket.bytes;
+        bucket.bytes = 0;
+        return bucket.builder->build();
+    }
+
+    // Пустые корзины прошедших партиций удаляются, чтобы долгая догрузка не копила построители
+    void trim() {
+        if (buckets_.size() <= kMaxIdleBuckets) {
+            return;
+        }
+        for (auto it = buckets_.begin(); it != buckets_.end();) {
+            it = it->second.builder->rows() == 0 ? buckets_.erase(it) : next(it);
+        }
+        last_ = nullptr;
+    }
+
+    TblCol columns_;
+    BatchLimits limits_;
+    PartitionKey partition_;
+    unordered_map<int64_t, Bucket> buckets_;
+    Bucket* last_ = nullptr;
+    int64_t lastKey_ = 0;
+    size_t rows_ = 0;
+    size_t bytes_ = 0;
+};
+
+// Накопитель строк одной таблицы с фоновым сбросом по возрасту пакета
+class TableBatcher {
+public:
+    TableBatcher(string table_name, const TblCol& columns, BatchLimits limits, FlushFn flush,
+                 PartitionKey partition = {})
+        : table_name_(move(table_name)), metricsTable_(metricsTable(table_name_)), limits_(limits), flush_(move(flush)),
+          builder_(columns, limits, partition) {
+        flusher_ = thread([this] { run(); });
+    }
+
+    TableBatcher(const TableBatcher&) = delete;
+    TableBatcher& operator=(const TableBatcher&) = delete;
+
+    ~TableBatcher() {
+        {
+            lock_guard<mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        flusher_.join();
+        // Штатно вызывающий сам делает flush(); здесь остаются только строки пути с ошибкой
+        try {
+            flush();
+        } catch (const exception& e) {
+            cerr << "Ошибка: не удалось сбросить пакет таблицы '" << table_name_ << "': " << e.what() << endl;
+        }
+    }
+
+    // Добавление преобразованной строки; при достижении порога пакет сбрасывается в вызывающем потоке
+    template <typename Values>
+    void add(const Values& values) {
+        vector<Batch> ready;
+        {
+            lock_guard<mutex> lock(mutex_);
+            rethrowBackgroundFailure();
+            bool wasEmpty = builder_.rows() == 0;
+            try {
+                builder_.appendRow(values, ready);
+            } catch (const invalid_argument&) {
+                addCounter(metricsTable_, Counter::RejectedRows);
+                throw;
+            }
+            if (wasEmpty) {
+                cv_.notify_all();
+            }
+        }
+        send(ready);
+    }
+
+    // Принудительный сброс накопленных строк
+    void flush() {
+        vector<Batch> ready;
+        {
+            lock_guard<mutex> lock(mutex_);
+            rethrowBackgroundFailure();
+            builder_.takeAll(ready);
+        }
+        send(ready);
+    }
+
+    const string& table() const {
+        return table_name_;
+    }
+
+private:
+    // Ошибка фонового сброса доходит до вызывающего при следующем add()/flush(), иначе потерянный
+    // пакет остался бы только в журнале, а загрузка завершилась бы успешно. Вызывается под mutex_
+    void rethrowBackgroundFailure() {
+        if (!backgroundFailure_) {
+            return;
+        }
+        string message = move(*backgroundFailure_);
+        backgroundFailure_.reset();
+        throw runtime_error("фоновый сброс пакета таблицы '" + table_name_ + "' не удался: " + message);
+    }
+
+    // Пакеты и их арены освобождаются целиком по выходе из send
+    void send(const vector<Batch>& batches) {
+        if (batches.empty()) {
+            return;
+        }
+        lock_guard<mutex> lock(sendMutex_);
+        for (const Batch& batch : batches) {
+            flush_(table_name_, batch.block);
+        }
+    }
+
+    // Фоновый поток: сбрасывает корзины, которые ждут дольше maxAge
+    void run() {
+        unique_lock<mutex> lock(mutex_);
+        while (!stopping_) {
+            auto deadline = builder_.deadline();
+            if (!deadline) {
+                cv_.wait(lock);
+                continue;
+            }
+            if (cv_.wait_until(lock, *deadline) != cv_status::timeout) {
+                continue;
+            }
+            vector<Batch> ready;
+            builder_.takeExpired(chrono::steady_clock::now(), ready);
+            if (ready.empty()) {
+                continue;
+            }
+            lock.unlock();
+            optional<string> failure;
+            try {
+                send(ready);
+            } catch (const exception& e) {
+                failure = e.what();
+            }
+            lock.lock();
+            if (failure && !backgroundFailure_) {
+                backgroundFailure_ = move(failure);
+            }
+        }
+    }
+
+    string table_name_;
+    size_t metricsTable_;
+    BatchLimits limits_;
+    FlushFn flush_;
+
+    mutex mutex_;
+    mutex sendMutex_;
+    condition_variable cv_;
+    PartitionedBuilder builder_;
+    bool stopping_ = false;
+    optional<string> backgroundFailure_;
+    thread flusher_;
+};
+
+#endif // BATCHER_H
@@ -0,0 +1,333 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "arena.h"
+#include "catalog.h"
+#include "datetime.h"
+#include "insert.h"
+#include "integers.h"
+#include "ip.h"
+#include "schemas.h"
+#include "sort.h"
+#include "types.h"
+
+using namespace std;
+
+// Микробенчмарки горячих путей: разбор типов, преобразование значений, сборка блока и сверка схем.
+// Результат в JSON: ./benchmarks --benchmark_out=result.json --benchmark_out_format=json
+
+namespace {
+
+// Текстовое значение столбца для синтетической строки; row задаёт разброс значений
+string sampleValue(ChType type, size_t row, mt19937& random) {
+    switch (type) {
+        case ChType::DateTime64_3:
+        case ChType::NullableDateTime64_3: {
+            char buffer[32];
+            int64_t ticks = 1711929600000 + static_cast<int64_t>(random() % 86400000);
+            size_t length = formatDateTime64(ticks, 3, buffer);
+            return string(buffer, length);
+        }
+        case ChType::UInt32:
+        case ChType::NullableUInt32:
+            return to_string(random() % 100000);
+        case ChType::NullableUInt8:
+            return to_string(random() % 256);
+        case ChType::NullableUInt16:
+            return to_string(random() % 65536);
+        case ChType::NullableUInt64:
+            return to_string((static_cast<uint64_t>(random()) << 32) | random());
+        case ChType::NullableString:
+            return "host-" + to_string(row % 64);
+        case ChType::NullableIPv4:
+            return "10." + to_string(random() % 256) + "." + to_string(random() % 256) + "." + to_string(random() % 256);
+        case ChType::NullableIPv6:
+            return "2001:db8::" + to_string(random() % 10000);
+    }
+    return string();
+}
+
+// Эталонная таблица с наибольшим числом столбцов: худший случай для построчных путей
+const TableDef& widestTable() {
+    auto schemas = getSchemas();
+    return *max_element(schemas.begin(), schemas.end(),
+                        [](const TableDef& a, const TableDef& b) { return a.columns.size() < b.columns.size(); });
+}
+
+TblCol tableColumns(const TableDef& table) {
+    TblCol columns;
+    for (const ColumnDef& column : table.columns) {
+        columns.emplace_back(string(column.name), string(typeName(column.type)));
+    }
+    return columns;
+}
+
+vector<vector<string>> sampleRows(const TableDef& table, size_t count) {
+    mt19937 random(42);
+    vector<vector<string>> rows(count);
+    for (size_t row = 0; row < count; ++row) {
+        for (const ColumnDef& column : table.columns) {
+            rows[row].push_back(sampleValue(column.type, row, random));
+        }
+    }
+    return rows;
+}
+
+vector<string> sampleValues(ChType type, size_t count) {
+    mt19937 random(7);
+    vector<string> values;
+    for (size_t i = 0; i < count; ++i) {
+        values.push_back(sampleValue(type, i, random));
+    }
+    return values;
+}
+
+// Исходная вставка через SQL: значения склеивались через ostringstream
+string join(const vector<string>& elements, const string& delimiter) {
+    ostringstream os;
+    for (auto it = elements.begin(); it != elements.end(); ++it) {
+        if (it != elements.begin()) {
+            os << delimiter;
+        }
+        os << *it;
+    }
+    return os.str();
+}
+
+}  // namespace
+
+static void BM_ParseTypeString(benchmark::State& state) {
+    vector<string_view> names;
+    for (const TableDef& table : getSchemas()) {
+        for (const ColumnDef& column : table.columns) {
+            names.push_back(typeName(column.type));
+        }
+    }
+    for (auto _ : state) {
+        for (string_view name : names) {
+            benchmark::DoNotOptimize(parseType(name));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(BM_ParseTypeString);
+
+static void BM_InternType(benchmark::State& state) {
+    vector<string> names;
+    for (const TableDef& table : getSchemas()) {
+        for (const ColumnDef& column : table.columns) {
+            names.emplace_back(typeName(column.type));
+        }
+    }
+    for (auto _ : state) {
+        for (const string& name : names) {
+            benchmark::DoNotOptimize(internType(name));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(BM_InternType);
+
+static void BM_FindSchema(benchmark::State& state) {
+    vector<string> names;
+    for (const TableDef& table : getSchemas()) {
+        names.emplace_back(table.name);
+    }
+    for (auto _ : state) {
+        for (const string& name : names) {
+            benchmark::DoNotOptimize(findSchema(name));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(BM_FindSchema);
+
+static void BM_ParseDateTime64(benchmark::State& state) {
+    vector<string> values = sampleValues(ChType::DateTime64_3, 1024);
+    for (auto _ : state) {
+        for (const string& value : values) {
+            int64_t ticks = 0;
+            benchmark::DoNotOptimize(parseDateTime64(value, 3, ticks));
+            benchmark::DoNotOptimize(ticks);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_ParseDateTime64);
+
+static void BM_ParseUInt32(benchmark::State& state) {
+    vector<string> values = sampleValues(ChType::UInt32, 1024);
+    for (auto _ : state) {
+        for (const string& value : values) {
+            uint32_t parsed = 0;
+            benchmark::DoNotOptimize(parseUInt(value, parsed));
+            benchmark::DoNotOptimize(parsed);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_ParseUInt32);
+
+static void BM_ParseUInt32Column(benchmark::State& state) {
+    vector<string> values = sampleValues(ChType::UInt32, 1024);
+    vector<string_view> views(values.begin(), values.end());
+    vector<uint32_t> parsed(views.size());
+    for (auto _ : state) {
+        ConvertError error = ConvertError::None;
+        benchmark::DoNotOptimize(parseUIntColumn<uint32_t>(views, parsed.data(), nullptr, error));
+        benchmark::DoNotOptimize(parsed.data());
+    }
+    state.SetItemsProcessed(state.iterations() * views.size());
+}
+BENCHMARK(BM_ParseUInt32Column);
+
+static void BM_ParseIPv4(benchmark::State& state) {
+    vector<string> values = sampleValues(ChType::NullableIPv4, 1024);
+    for (auto _ : state) {
+        for (const string& value : values) {
+            uint32_t address = 0;
+            benchmark::DoNotOptimize(parseIPv4(value, address));
+            benchmark::DoNotOptimize(address);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_ParseIPv4);
+
+static void BM_ParseIPv6(benchmark::State& state) {
+    vector<string> values = sampleValues(ChType::NullableIPv6, 1024);
+    for (auto _ : state) {
+        for (const string& value : values) {
+            array<uint8_t, 16> address;
+            benchmark::DoNotOptimize(parseIPv6(value, address));
+            benchmark::DoNotOptimize(address);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_ParseIPv6);
+
+static void BM_ArenaCopyString(benchmark::State& state) {
+    vector<string> values = sampleValues(ChType::NullableString, 1024);
+    for (auto _ : state) {
+        StringArena arena;
+        for (const string& value : values) {
+            benchmark::DoNotOptimize(arena.copy(value));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_ArenaCopyString);
+
+// Старый путь: текст INSERT ... VALUES, собранный join() для каждой строки
+static void BM_JoinInsertQuery(benchmark::State& state) {
+    const TableDef& table = widestTable();
+    vector<vector<string>> rows = sampleRows(table, static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        string query = "INSERT INTO " + string(table.name) + " VALUES ";
+        for (size_t i = 0; i < rows.size(); ++i) {
+            vector<string> quoted;
+            for (const string& value : rows[i]) {
+                quoted.push_back("'" + value + "'");
+            }
+            query += (i == 0 ? "(" : ", (") + join(quoted, ", ") + ")";
+        }
+        benchmark::DoNotOptimize(query.data());
+    }
+    state.SetItemsProcessed(state.iterations() * rows.size());
+}
+BENCHMARK(BM_JoinInsertQuery)->Arg(1000)->Arg(10000);
+
+// Текущий путь: типизированные столбцы нативного Block
+static void BM_BuildNativeBlock(benchmark::State& state) {
+    const TableDef& table = widestTable();
+    TblCol columns = tableColumns(table);
+    vector<vector<string>> rows = sampleRows(table, static_cast<size_t>(state.range(0)));
+    BlockBuilder builder(columns);
+    for (auto _ : state) {
+        for (const auto& row : rows) {
+            builder.appendRow(row);
+        }
+        Batch batch = builder.build();
+        benchmark::DoNotOptimize(batch.block.GetRowCount());
+    }
+    state.SetItemsProcessed(state.iterations() * rows.size());
+}
+BENCHMARK(BM_BuildNativeBlock)->Arg(1000)->Arg(10000);
+
+// Пакетный путь воспроизведения спула: столбцы UInt разбираются целиком
+static void BM_AppendRowsNativeBlock(benchmark::State& state) {
+    const TableDef& table = widestTable();
+    TblCol columns = tableColumns(table);
+    vector<vector<string>> rows = sampleRows(table, static_cast<size_t>(state.range(0)));
+    vector<string_view> values;
+    for (const auto& row : rows) {
+        values.insert(values.end(), row.begin(), row.end());
+    }
+    BlockBuilder builder(columns);
+    for (auto _ : state) {
+        builder.appendRows(values);
+        Batch batch = builder.build();
+        benchmark::DoNotOptimize(batch.block.GetRowCount());
+    }
+    state.SetItemsProcessed(state.iterations() * rows.size());
+}
+BENCHMARK(BM_AppendRowsNativeBlock)->Arg(1000)->Arg(10000);
+
+// Сборка блока с сортировкой строк по datetime
+static void BM_BuildSortedBlock(benchmark::State& state) {
+    const TableDef& table = widestTable();
+    TblCol columns = tableColumns(table);
+    vector<vector<string>> rows = sampleRows(table, static_cast<size_t>(state.range(0)));
+    BlockBuilder builder(columns);
+    builder.sortBy("datetime");
+    for (auto _ : state) {
+        for (const auto& row : rows) {
+            builder.appendRow(row);
+        }
+        Batch batch = builder.build();
+        benchmark::DoNotOptimize(batch.block.GetRowCount());
+    }
+    state.SetItemsProcessed(state.iterations() * rows.size());
+}
+BENCHMARK(BM_BuildSortedBlock)->Arg(1000)->Arg(10000);
+
+static void BM_RadixSortOrder(benchmark::State& state) {
+    mt19937_64 random(1);
+    vector<int64_t> keys(static_cast<size_t>(state.range(0)));
+    for (auto& key : keys) {
+        key = 1711929600000 + static_cast<int64_t>(random() % 86400000);
+    }
+    vector<uint32_t> order;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(radixSortOrder(keys, order));
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_RadixSortOrder)->Arg(1000)->Arg(100000);
+
+// Сверка схем всех эталонных таблиц, как при запуске
+static void BM_CompareAllSchemas(benchmark::State& state) {
+    vector<pair<string, TblCol>> actual;
+    for (const TableDef& table : getSchemas()) {
+        actual.emplace_back(string(table.name), tableColumns(table));
+    }
+    for (auto _ : state) {
+        bool match = true;
+        for (const auto& [name, columns] : actual) {
+            const TableDef* expected = findSchema(name);
+            match &= expected && compareSchema(columns, *expected);
+        }
+        benchmark::DoNotOptimize(match);
+    }
+    state.SetItemsProcessed(state.iterations() * actual.size());
+}
+BENCHMARK(BM_CompareAllSchemas);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,95 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <clickhouse/client.h>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "schemas.h"
+#include "server_stats.h"
+#include "trace.h"
+#include "types.h"
+
+using namespace clickhouse;
+using namespace std;
+
+// Метаданные базы: список таблиц, схемы и ключи партиционирования, сверка с эталоном schemas.h
+
+inline vector<string> getTables(Client& client) {
+    TraceSpan span("get_tables");
+    vector<string> tables;
+    Query query("SHOW TABLES");
+    query.OnData([&](const Block& block) {
+        for (size_t i = 0; i < block.GetRowCount(); ++i) {
+            string table(block[0]->As<ColumnString>()->At(i));
+            tables.push_back(table);
+        }
+    });
+    ServerQuery stats(query, kMetricsSystemQueries);
+    client.Select(query);
+    return tables;
+}
+
+// Получение схем всех таблиц текущей базы одним запросом к system.columns
+inline unordered_map<string, TblCol> getDbSchema(Client& client) {
+    TraceSpan span("get_db_schema");
+    unordered_map<string, TblCol> schemas;
+    Query query("SELECT table, name, type, position FROM system.columns "
+                "WHERE database = currentDatabase() ORDER BY table, position");
+    query.OnData([&](const Block& block) {
+        auto tables = block[0]->As<ColumnString>();
+        auto names = block[1]->As<ColumnString>();
+        auto types = block[2]->As<ColumnString>();
+        auto positions = block[3]->As<ColumnUInt64>();
+        for (size_t i = 0; i < block.GetRowCount(); ++i) {
+            TblCol& columns = schemas[string(tables->At(i))];
+            size_t position = positions->At(i);
+            if (columns.size() < position) {
+                columns.resize(position);
+            }
+            columns[position - 1] = Col(names->At(i), types->At(i));
+        }
+    });
+    ServerQuery stats(query, kMetricsSystemQueries);
+    client.Select(query);
+    return schemas;
+}
+
+// Выражения ключей партиционирования таблиц текущей базы
+inline unordered_map<string, string> getPartitionKeys(Client& client) {
+    TraceSpan span("get_partition_keys");
+    unordered_map<string, string> keys;
+    Query query("SELECT name, partition_key FROM system.tables WHERE database = currentDatabase()");
+    query.OnData([&](const Block& block) {
+        auto names = block[0]->As<ColumnString>();
+        auto expressions = block[1]->As<ColumnString>();
+        for (size_t i = 0; i < block.GetRowCount(); ++i) {
+            keys.emplace(names->At(i), expressions->At(i));
+        }
+    });
+    ServerQuery stats(query, kMetricsSystemQueries);
+    client.Select(query);
+    return keys;
+}
+
+inline bool compareSchema(const TblCol& actual, const TableDef& expected) {
+    TraceSpan span("compare_schema", expected.name);
+    if (actual.size() != expected.columns.size()) {
+        cerr << "Ошибка: Количество столбцов не совпадает." << endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < actual.size(); ++i) {
+        const ColumnDef& column = expected.columns[i];
+        if (actual[i].first != column.name || internType(actual[i].second) != typeId(column.type)) {
+            cerr << "Ошибка: Несоответствие в столбце '" << actual[i].first << "'. Ожидаемый тип: "
+                 << typeName(column.type) << ", фактический тип: " << actual[i].second << "." << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif // CATALOG_H
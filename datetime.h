@@ -0,0 +1,188 @@
+#ifndef DATETIME_H
+#define DATETIME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+using namespace std;
+
+// Смещение от UTC (в секундах) для значений без явного часового пояса; задаётся один раз при запуске
+// параметром --tz. По умолчанию такие значения считаются UTC, а не местным временем машины загрузчика
+inline int32_t inputUtcOffsetSeconds = 0;
+
+inline constexpr int64_t kPow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+// Количество дней до начала месяца в невисокосном году
+inline constexpr uint16_t kDaysBeforeMonth[13] = {0, 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+inline constexpr uint8_t kDaysInMonth[13] = {0, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+constexpr bool isLeapYear(int64_t y) {
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+// Число дней от 1970-01-01 до заданной даты пролептического григорианского календаря
+constexpr int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+    int64_t yp = y - 1;
+    int64_t days = yp * 365 + yp / 4 - yp / 100 + yp / 400 + kDaysBeforeMonth[m] + d - 1;
+    if (m > 2 && isLeapYear(y)) {
+        ++days;
+    }
+    return days - 719162;
+}
+
+// Обратное преобразование (алгоритм Хиннанта)
+constexpr void civilFromDays(int64_t z, int64_t& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = static_cast<unsigned>(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+}
+
+constexpr unsigned digit(char c) {
+    return static_cast<unsigned>(static_cast<unsigned char>(c) - '0');
+}
+
+constexpr unsigned digits2(const char* p) {
+    return digit(p[0]) * 10 + digit(p[1]);
+}
+
+// Разбор "YYYY-MM-DD HH:MM:SS[.f...]" и вариантов ISO-8601 ("T" вместо пробела, суффикс Z, ±HH:MM, ±HHMM, ±HH)
+// в тики DateTime64 заданной точности. Без исключений и выделений памяти; false при неверном формате.
+inline bool parseDateTime64(string_view s, unsigned precision, int64_t& ticks) {
+    constexpr string_view kLayout = "dddd-dd-dd?dd:dd:dd";
+    if (s.size() < kLayout.size() || precision > 9) {
+        return false;
+    }
+
+    // Проверка всех позиций без ранних выходов: цикл без ветвлений хорошо векторизуется
+    bool ok = true;
+    for (size_t i = 0; i < kLayout.size(); ++i) {
+        char c = s[i];
+        char l = kLayout[i];
+        ok &= l == 'd' ? digit(c) < 10 : l == '?' ? (c == ' ' || c == 'T') : c == l;
+    }
+    if (!ok) {
+        return false;
+    }
+
+    int64_t year = digits2(s.data()) * 100 + digits2(s.data() + 2);
+    unsigned month = digits2(s.data() + 5);
+    unsigned day = digits2(s.data() + 8);
+    unsigned hour = digits2(s.data() + 11);
+    unsigned minute = digits2(s.data() + 14);
+    unsigned second = digits2(s.data() + 17);
+    if (month - 1 > 11 || day - 1 >= kDaysInMonth[month] || (month == 2 && day == 29 && !isLeapYear(year)) ||
+        hour > 23 || minute > 59 || second > 59) {
+        return false;
+    }
+
+    size_t pos = kLayout.size();
+    int64_t fraction = 0;
+    if (pos < s.size() && s[pos] == '.') {
+        size_t start = ++pos;
+        while (pos < s.size() && digit(s[pos]) < 10) {
+            if (pos - start < precision) {
+                fraction = fraction * 10 + digit(s[pos]);
+            }
+            ++pos;
+        }
+        size_t count = pos - start;
+        if (count == 0) {
+            return false;
+        }
+        if (count < precision) {
+            fraction *= kPow10[precision - count];
+        }
+    }
+
+    int64_t offset = inputUtcOffsetSeconds;
+    if (pos < s.size()) {
+        char sign = s[pos++];
+        if (sign == 'Z' && pos == s.size()) {
+            offset = 0;
+        } else if (sign == '+' || sign == '-') {
+            string_view tz = s.substr(pos);
+            unsigned hh = 0;
+            unsigned mm = 0;
+            if (tz.size() == 2 || tz.size() == 4 || (tz.size() == 5 && tz[2] == ':')) {
+                bool digits = digit(tz[0]) < 10 && digit(tz[1]) < 10;
+                hh = digits2(tz.data());
+                if (tz.size() > 2) {
+                    const char* m = tz.data() + tz.size() - 2;
+                    digits &= digit(m[0]) < 10 && digit(m[1]) < 10;
+                    mm = digits2(m);
+                }
+                if (!digits || hh > 23 || mm > 59) {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+            offset = (sign == '-' ? -1 : 1) * static_cast<int64_t>(hh * 3600 + mm * 60);
+        } else {
+            return false;
+        }
+    }
+
+    int64_t seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offset;
+    ticks = seconds * kPow10[precision] + fraction;
+    return true;
+}
+
+// Форматирование тиков DateTime64 в "YYYY-MM-DD HH:MM:SS.fff" (UTC); out должен вмещать 30 символов.
+// Возвращает длину записанной строки.
+inline size_t formatDateTime64(int64_t ticks, unsigned precision, char* out) {
+    int64_t scale = kPow10[precision];
+    int64_t seconds = ticks / scale;
+    int64_t fraction = ticks % scale;
+    if (fraction < 0) {
+        fraction += scale;
+        --seconds;
+    }
+    int64_t days = seconds / 86400;
+    int64_t rem = seconds % 86400;
+    if (rem < 0) {
+        rem += 86400;
+        --days;
+    }
+    int64_t year = 0;
+    unsigned month = 0;
+    unsigned day = 0;
+    civilFromDays(days, year, month, day);
+
+    auto put2 = [](char* p, unsigned v) {
+        p[0] = static_cast<char>('0' + v / 10);
+        p[1] = static_cast<char>('0' + v % 10);
+    };
+    unsigned y = static_cast<unsigned>(year % 10000);
+    put2(out, y / 100);
+    put2(out + 2, y % 100);
+    out[4] = '-';
+    put2(out + 5, month);
+    out[7] = '-';
+    put2(out + 8, day);
+    out[10] = ' ';
+    put2(out + 11, static_cast<unsigned>(rem / 3600));
+    out[13] = ':';
+    put2(out + 14, static_cast<unsigned>(rem / 60 % 60));
+    out[16] = ':';
+    put2(out + 17, static_cast<unsigned>(rem % 60));
+    size_t length = 19;
+    if (precision > 0) {
+        out[length++] = '.';
+        for (unsigned i = precision; i-- > 0;) {
+            out[length + i] = static_cast<char>('0' + fraction % 10);
+            fraction /= 10;
+        }
+        length += precision;
+    }
+    return length;
+}
+
+#endif // DATETIME_H
@@ -0,0 +1,409 @@
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "batcher.h"
+#include "datetime.h"
+#include "ingest.h"
+#include "pool.h"
+#include "schemas.h"
+#include "spool.h"
+
+using namespace std;
+
+// Параметры режима generate: синтетические события по эталонным схемам для нагрузочных тестов
+struct GenerateOptions {
+    // Пусто — все эталонные таблицы, которые есть в базе
+    vector<string> tables;
+    // Всего строк по всем таблицам; 0 — без ограничения, до истечения duration
+    size_t rows = 1000000;
+    chrono::seconds duration{0};
+    // Суммарная скорость, строк/с; 0 — без ограничения
+    double rate = 0;
+    size_t threads = 1;
+    // Число различных значений строковых и целочисленных столбцов
+    size_t cardinality = 1000;
+    // Доля NULL в столбцах Nullable
+    double nullRatio = 0.1;
+    // Доля событий с адресами IPv6; в остальных заполнены столбцы IPv4
+    double ipv6Ratio = 0.2;
+    // Число подсетей (/24 для IPv4, /64 для IPv6), из которых берутся адреса
+    size_t subnets = 16;
+    // Метки времени отстают от текущего момента на случайную величину до skew
+    chrono::milliseconds skew{0};
+    uint64_t seed = 1;
+    // Каталог для файлов <таблица>.csv вместо вставки в базу
+    string outDir;
+};
+
+// Генератор строк одной таблицы: значения в текстовом виде, как их отдаёт читатель входа,
+// поэтому вставка проходит тот же путь разбора, что и при загрузке реальных данных
+class RowGenerator {
+public:
+    RowGenerator(const TableDef& table, const GenerateOptions& options, uint64_t seed)
+        : table_(table), options_(options), random_(seed), values_(table.columns.size()),
+          msgtype_(to_string(tableIndex(table.name))) {}
+
+    // Очередная строка; пустое значение означает NULL. Действительна до следующего вызова
+    const vector<string>& next() {
+        int64_t now = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+        bool ipv6 = chance(options_.ipv6Ratio);
+        for (size_t i = 0; i < table_.columns.size(); ++i) {
+            const ColumnDef& column = table_.columns[i];
+            string& out = values_[i];
+            out.clear();
+            if (column.name == "msgtype") {
+                out = msgtype_;
+                continue;
+            }
+            bool nullable = column.type != ChType::DateTime64_3 && column.type != ChType::UInt32;
+            if (nullable && chance(options_.nullRatio)) {
+                continue;
+            }
+            switch (column.type) {
+                case ChType::DateTime64_3:
+                case ChType::NullableDateTime64_3: {
+                    int64_t lag = options_.skew.count() > 0 ? static_cast<int64_t>(random_() % options_.skew.count()) : 0;
+                    char buffer[32];
+                    out.assign(buffer, formatDateTime64(now - lag, 3, buffer));
+                    break;
+                }
+                case ChType::UInt32:
+                case ChType::NullableUInt32:
+                    appendNumber(out, pick(options_.cardinality));
+                    break;
+                case ChType::NullableUInt8:
+                    appendNumber(out, pick(min<size_t>(options_.cardinality, 256)));
+                    break;
+                case ChType::NullableUInt16:
+                    appendNumber(out, pick(min<size_t>(options_.cardinality, 65536)));
+                    break;
+                case ChType::NullableUInt64:
+                    // Значения разносятся по всему диапазону, как идентификаторы сессий и MAC-адреса
+                    appendNumber(out, pick(options_.cardinality) * 0x9E3779B97F4A7C15ULL);
+                    break;
+                case ChType::NullableString:
+                    out.append(column.name).push_back('-');
+                    appendNumber(out, pick(options_.cardinality));
+                    break;
+                case ChType::NullableIPv4:
+                    if (!ipv6) {
+                        appendIPv4(out);
+                    }
+                    break;
+                case ChType::NullableIPv6:
+                    if (ipv6) {
+                        appendIPv6(out);
+                    }
+                    break;
+            }
+        }
+        return values_;
+    }
+
+private:
+    bool chance(double probability) {
+        return probability > 0 && uniform_real_distribution<double>(0, 1)(random_) < probability;
+    }
+
+    uint64_t pick(size_t count) {
+        return count > 1 ? random_() % count : 0;
+    }
+
+    static void appendNumber(string& out, uint64_t value) {
+        char buffer[24];
+        out.append(buffer, to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+    }
+
+    static void appendHex(string& out, uint64_t value) {
+        char buffer[24];
+        out.append(buffer, to_chars(buffer, buffer + sizeof(buffer), value, 16).ptr);
+    }
+
+    // 10.x.y.h: подсеть /24 из options.subnets, узел 1..254
+    void appendIPv4(string& out) {
+        uint64_t subnet = pick(options_.subnets);
+        out.append("10.");
+        appendNumber(out, (subnet >> 8) & 0xFF);
+        out.push_back('.');
+        appendNumber(out, subnet & 0xFF);
+        out.push_back('.');
+        appendNumber(out, 1 + pick(254));
+    }
+
+    // 2001:db8:s::h: подсеть /64 из options.subnets
+    void appendIPv6(string& out) {
+        out.append("2001:db8:");
+        appendHex(out, pick(options_.subnets) & 0xFFFF);
+        out.append("::");
+        appendHex(out, 1 + pick(0xFFFE));
+    }
+
+    const TableDef& table_;
+    const GenerateOptions& options_;
+    mt19937_64 random_;
+    vector<string> values_;
+    string msgtype_;
+};
+
+// Разбор аргументов: generate [--tables t_a,t_b] [--rows N] [--duration S] [--rate N] [--threads N]
+//                              [--cardinality N] [--null-ratio F] [--ipv6-ratio F] [--subnets N] [--skew-ms N]
+//                              [--seed N] [--out DIR] [параметры загрузки]
+// Параметры загрузки (--batch-rows, --inserters, --spool и т. д.) передаются в ingest.
+inline GenerateOptions parseGenerateArgs(const vector<string>& args, IngestOptions& ingest) {
+    GenerateOptions options;
+    vector<string> rest = {"--route"};
+    for (size_t i = 0; i < args.size(); ++i) {
+        const string& arg = args[i];
+        auto value = [&]() -> const string& {
+            if (i + 1 >= args.size()) {
+                throw invalid_argument("Для параметра " + arg + " не указано значение");
+            }
+            return args[++i];
+        };
+        auto ratio = [&]() {
+            double r = stod(value());
+            if (r < 0 || r > 1) {
+                throw invalid_argument("Значение " + arg + " должно быть от 0 до 1");
+            }
+            return r;
+        };
+        if (arg == "--tables") {
+            const string& list = value();
+            for (size_t start = 0; start <= list.size();) {
+                size_t comma = min(list.find(',', start), list.size());
+                if (comma > start) {
+                    options.tables.push_back(list.substr(start, comma - start));
+                }
+                start = comma + 1;
+            }
+        } else if (arg == "--rows") {
+            options.rows = stoull(value());
+        } else if (arg == "--duration") {
+            options.duration = chrono::seconds(stoll(value()));
+        } else if (arg == "--rate") {
+            options.rate = stod(value());
+        } else if (arg == "--threads") {
+            options.threads = max<size_t>(1, stoull(value()));
+        } else if (arg == "--cardinality") {
+            options.cardinality = max<size_t>(1, stoull(value()));
+        } else if (arg == "--null-ratio") {
+            options.nullRatio = ratio();
+        } else if (arg == "--ipv6-ratio") {
+            options.ipv6Ratio = ratio();
+        } else if (arg == "--subnets") {
+            options.subnets = max<size_t>(1, stoull(value()));
+        } else if (arg == "--skew-ms") {
+            options.skew = chrono::milliseconds(stoll(value()));
+        } else if (arg == "--seed") {
+            options.seed = stoull(value());
+        } else if (arg == "--out") {
+            options.outDir = value();
+        } else {
+            rest.push_back(arg);
+        }
+    }
+    ingest = parseIngestArgs(rest);
+    if (ingest.path != "-") {
+        throw invalid_argument("Лишний аргумент: " + ingest.path + " (таблицы задаются через --tables)");
+    }
+    if (options.rows == 0 && options.duration.count() == 0) {
+        throw invalid_argument("Без --rows нужен --duration: иначе генерация не остановится");
+    }
+    return options;
+}
+
+// Нагрузочный генератор: потоки по очереди порождают строки выбранных таблиц и передают их
+// в накопители таблиц (тот же путь, что у ingest) либо в файлы CSV. Скорость делится между
+// потоками поровну; каждый поток выдерживает свою долю, сверяясь с часами раз в 256 строк.
+class EventGenerator {
+public:
+    EventGenerator(ConnectionPool* pool, Spool* spool, const unordered_map<string, TblCol>& schemas,
+                   const GenerateOptions& options, const IngestOptions& ingest)
+        : pool_(pool), spool_(spool), options_(options) {
+        vector<string> names = options_.tables;
+        if (names.empty()) {
+            for (const TableDef& table : getSchemas()) {
+                if (schemas.count(string(table.name))) {
+                    names.emplace_back(table.name);
+                }
+            }
+        }
+        for (const string& name : names) {
+            const TableDef* table = findSchema(name);
+            auto schema = schemas.find(name);
+            if (!table || schema == schemas.end()) {
+                throw invalid_argument("Таблица '" + name + "' не найдена.");
+            }
+            auto target = make_unique<Target>();
+            target->table = table;
+            target->columns = &schema->second;
+            if (options_.outDir.empty()) {
+                const TblCol& columns = schema->second;
+                target->batcher = make_unique<TableBatcher>(name, columns, ingest.limits,
+                    [this, &columns](const string& table_name, const Block& block) {
+                        insertOrSpool(*pool_, spool_, table_name, columns, block);
+                    }, partitionKeyFor(ingest, name, columns));
+            } else {
+                string path = options_.outDir + "/" + name + ".csv";
+                target->file.open(path, ios::binary | ios::trunc);
+                if (!target->file) {
+                    throw runtime_error("Не удалось открыть файл " + path);
+                }
+            }
+            targets_.push_back(move(target));
+        }
+        if (targets_.empty()) {
+            throw invalid_argument("Нет таблиц для генерации");
+        }
+    }
+
+    EventGenerator(const EventGenerator&) = delete;
+    EventGenerator& operator=(const EventGenerator&) = delete;
+
+    int run() {
+        auto started = chrono::steady_clock::now();
+        vector<thread> threads;
+        for (size_t i = 0; i < options_.threads; ++i) {
+            size_t quota = options_.rows / options_.threads + (i < options_.rows % options_.threads ? 1 : 0);
+            if (options_.rows > 0 && quota == 0) {
+                continue;
+            }
+            threads.emplace_back([this, i, quota, started] { work(i, quota, started); });
+        }
+        for (thread& t : threads) {
+            t.join();
+        }
+
+        try {
+            for (auto& target : targets_) {
+                if (target->batcher) {
+                    target->batcher->flush();
+                }
+            }
+            if (error_) {
+                rethrow_exception(error_);
+            }
+        } catch (const exception& e) {
+            cerr << "Ошибка: " << e.what() << endl;
+            return 1;
+        }
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        size_t total = 0;
+        cout << "Сгенерировано строк по таблицам:" << endl;
+        for (const auto& target : targets_) {
+            size_t rows = target->rows.load();
+            total += rows;
+            cout << "- " << target->table->name << ": " << rows << endl;
+        }
+        cout << "Сгенерировано строк: " << total << ", время: " << seconds << " с, скорость: "
+             << static_cast<size_t>(seconds > 0 ? total / seconds : 0) << " строк/с." << endl;
+        return 0;
+    }
+
+private:
+    static constexpr size_t kFileBufferBytes = 1 << 20;
+
+    struct Target {
+        const TableDef* table = nullptr;
+        const TblCol* columns = nullptr;
+        unique_ptr<TableBatcher> batcher;
+        mutex fileMutex;
+        ofstream file;
+        atomic<size_t> rows{0};
+    };
+
+    void work(size_t index, size_t quota, chrono::steady_clock::time_point started) {
+        vector<RowGenerator> generators;
+        vector<string> buffers(targets_.size());
+        for (size_t t = 0; t < targets_.size(); ++t) {
+            // Последовательность строк зависит только от seed, номера потока и таблицы
+            generators.emplace_back(*targets_[t]->table, options_, options_.seed * 1000003 + index * 1009 + t);
+        }
+        double threadRate = options_.rate / static_cast<double>(options_.threads);
+        auto deadline = started + options_.duration;
+
+        try {
+            for (size_t row = 0; (quota == 0 || row < quota) && !failed_.load(memory_order_relaxed); ++row) {
+                if (row % 256 == 0) {
+                    auto now = chrono::steady_clock::now();
+                    if (options_.duration.count() > 0 && now >= deadline) {
+                        break;
+                    }
+                    if (threadRate > 0) {
+                        this_thread::sleep_until(started + chrono::duration_cast<chrono::steady_clock::duration>(
+                                                               chrono::duration<double>(row / threadRate)));
+                    }
+                }
+                size_t t = (index + row) % targets_.size();
+                Target& target = *targets_[t];
+                const vector<string>& values = generators[t].next();
+                if (target.batcher) {
+                    target.batcher->add(values);
+                } else {
+                    appendCsv(buffers[t], values);
+                    if (buffers[t].size() >= kFileBufferBytes) {
+                        write(target, buffers[t]);
+                    }
+                }
+                target.rows.fetch_add(1, memory_order_relaxed);
+            }
+            for (size_t t = 0; t < targets_.size(); ++t) {
+                write(*targets_[t], buffers[t]);
+            }
+        } catch (...) {
+            lock_guard<mutex> lock(errorMutex_);
+            if (!error_) {
+                error_ = current_exception();
+            }
+            failed_ = true;
+        }
+    }
+
+    // Значения генератора не содержат запятых и кавычек, поэтому экранирование не нужно
+    static void appendCsv(string& buffer, const vector<string>& values) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (i > 0) {
+                buffer.push_back(',');
+            }
+            buffer.append(values[i]);
+        }
+        buffer.push_back('\n');
+    }
+
+    static void write(Target& target, string& buffer) {
+        if (buffer.empty()) {
+            return;
+        }
+        lock_guard<mutex> lock(target.fileMutex);
+        if (!target.file.write(buffer.data(), static_cast<streamsize>(buffer.size()))) {
+            throw runtime_error("Ошибка записи файла таблицы " + string(target.table->name));
+        }
+        buffer.clear();
+    }
+
+    ConnectionPool* pool_;
+    Spool* spool_;
+    const GenerateOptions& options_;
+    vector<unique_ptr<Target>> targets_;
+    atomic<bool> failed_{false};
+    mutex errorMutex_;
+    exception_ptr error_;
+};
+
+#endif // GENERATE_H
@@ -0,0 +1,623 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "batcher.h"
+#include "mapped_file.h"
+#include "pool.h"
+#include "spool.h"
+
+using namespace std;
+
+enum class IngestFormat {
+    Csv,
+    Tsv,
+    JsonLines,
+};
+
+// Параметры режима ingest
+struct IngestOptions {
+    string table;
+    string path = "-";
+    IngestFormat format = IngestFormat::Csv;
+    bool header = false;
+    BatchLimits limits;
+    size_t parsers = 1;
+    size_t inserters = 1;
+    string spoolDir;
+    // Маршрутизация смешанного потока по таблицам вместо загрузки в одну таблицу
+    bool route = false;
+    string discriminator = "msgtype";
+    vector<pair<string, string>> routes;
+    // Приём syslog по сети (режим listen)
+    string listenAddress = "0.0.0.0";
+    uint16_t udpPort = 0;
+    uint16_t tcpPort = 0;
+    // Выражения partition_key таблиц из system.tables, читаются один раз при запуске
+    unordered_map<string, string> partitionKeys;
+    bool splitPartitions = true;
+    // Метрики: эндпоинт Prometheus на 127.0.0.1 и/или файл для textfile-коллектора
+    uint16_t metricsPort = 0;
+    string metricsFile;
+    // Файл трассы Chrome trace-event; выгружается при завершении и по SIGUSR1
+    string tracePath;
+};
+
+// Ключ партиционирования таблицы для разбиения пакетов; пустой, если разбиение отключено
+inline PartitionKey partitionKeyFor(const IngestOptions& options, const string& table, const TblCol& columns) {
+    auto it = options.partitionKeys.find(table);
+    if (!options.splitPartitions || it == options.partitionKeys.end()) {
+        return PartitionKey{};
+    }
+    return parsePartitionKey(it->second, columns);
+}
+
+// Источник записей: каждая запись — значения в порядке столбцов таблицы, пустое значение означает NULL.
+// Представления указывают во входной буфер или во внутренний буфер читателя и действительны до следующего next().
+class RecordReader {
+public:
+    virtual ~RecordReader() = default;
+    virtual bool next(vector<string_view>& values) = 0;
+};
+
+// Выделение очередной непустой строки входа; quoteAware учитывает переводы строк внутри кавычек CSV
+inline bool nextLine(InputSource& source, string_view& line, bool quoteAware) {
+    while (true) {
+        string_view data = source.data();
+        size_t end = string_view::npos;
+        const char* nl = static_cast<const char*>(memchr(data.data(), '\n', data.size()));
+        if (nl) {
+            end = static_cast<size_t>(nl - data.data());
+            if (quoteAware && memchr(data.data(), '"', end)) {
+                bool quoted = false;
+                end = string_view::npos;
+                for (size_t i = 0; i < data.size(); ++i) {
+                    if (data[i] == '"') {
+                        quoted = !quoted;
+                    } else if (data[i] == '\n' && !quoted) {
+                        end = i;
+                        break;
+                    }
+                }
+            }
+        }
+        if (end == string_view::npos) {
+            if (source.fill()) {
+                continue;
+            }
+            if (data.empty()) {
+                return false;
+            }
+            end = data.size();
+        }
+
+        line = data.substr(0, end);
+        source.consume(min(end + 1, data.size()));
+        if (end + 1 < data.size()) {
+            __builtin_prefetch(data.data() + end + 1 + 256);
+        }
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            return true;
+        }
+    }
+}
+
+// CSV/TSV: поля по порядку столбцов или по строке заголовка
+class DelimitedReader : public RecordReader {
+public:
+    DelimitedReader(InputSource& source, const TblCol& columns, IngestFormat format, bool header)
+        : source_(source), columns_(columns), delimiter_(format == IngestFormat::Tsv ? '\t' : ','),
+          tsv_(format == IngestFormat::Tsv) {
+        if (header) {
+            if (!readFields()) {
+                throw invalid_argument("Файл пуст: отсутствует строка заголовка");
+            }
+            mapping_ = mapHeader(fields_);
+        }
+    }
+
+    // Читатель с уже разобранным заголовком, например для чанков файла в рабочих потоках
+    DelimitedReader(InputSource& source, const TblCol& columns, IngestFormat format, vector<int> mapping)
+        : source_(source), columns_(columns), delimiter_(format == IngestFormat::Tsv ? '\t' : ','),
+          tsv_(format == IngestFormat::Tsv), mapping_(move(mapping)) {}
+
+    // Соответствие полей заголовка столбцам таблицы; пусто, если заголовка нет
+    const vector<int>& mapping() const {
+        return mapping_;
+    }
+
+    bool next(vector<string_view>& values) override {
+        if (!readFields()) {
+            return false;
+        }
+        if (mapping_.empty()) {
+            if (fields_.size() != columns_.size()) {
+                throw invalid_argument("Ожидалось полей: " + to_string(columns_.size()) + ", получено: " +
+                                       to_string(fields_.size()));
+            }
+            values.assign(fields_.begin(), fields_.end());
+        } else {
+            values.assign(columns_.size(), string_view());
+            for (size_t i = 0; i < fields_.size() && i < mapping_.size(); ++i) {
+                if (mapping_[i] >= 0) {
+                    values[mapping_[i]] = fields_[i];
+                }
+            }
+        }
+        return true;
+    }
+
+    // Поля очередной записи без сопоставления со столбцами
+    bool nextFields(vector<string_view>& fields) {
+        if (!readFields()) {
+            return false;
+        }
+        fields.assign(fields_.begin(), fields_.end());
+        return true;
+    }
+
+private:
+    vector<int> mapHeader(const vector<string_view>& names) {
+        vector<int> mapping(names.size(), -1);
+        for (size_t i = 0; i < names.size(); ++i) {
+            for (size_t j = 0; j < columns_.size(); ++j) {
+                if (columns_[j].first == names[i]) {
+                    mapping[i] = static_cast<int>(j);
+                }
+            }
+            if (mapping[i] < 0) {
+                cerr << "Предупреждение: столбец '" << names[i] << "' отсутствует в таблице и будет пропущен." << endl;
+            }
+        }
+        return mapping;
+    }
+
+    // Разбиение строки на поля; поля без кавычек и экранирования ссылаются прямо во входной буфер
+    bool readFields() {
+        string_view line;
+        if (!nextLine(source_, line, !tsv_)) {
+            return false;
+        }
+        fields_.clear();
+        scratch_.clear();
+        // Распакованное поле не длиннее исходного, поэтому буфер не перераспределяется и представления в нём стабильны
+        scratch_.reserve(line.size());
+
+        size_t pos = 0;
+        while (true) {
+            size_t end = line.find(delimiter_, pos);
+            string_view raw = line.substr(pos, end == string_view::npos ? string_view::npos : end - pos);
+            if (!tsv_ && !raw.empty() && raw.front() == '"') {
+                end = unquote(line, pos);
+            } else if (tsv_ && raw.find('\\') != string_view::npos) {
+                fields_.push_back(unescape(raw));
+            } else {
+                fields_.push_back(raw);
+            }
+            if (end == string_view::npos) {
+                return true;
+            }
+            pos = end + 1;
+        }
+    }
+
+    // Поле CSV в кавычках: удвоенная кавычка внутри означает одну кавычку
+    size_t unquote(string_view line, size_t pos) {
+        size_t start = scratch_.size();
+        size_t i = pos + 1;
+        while (true) {
+            size_t quote = line.find('"', i);
+            if (quote == string_view::npos) {
+                throw invalid_argument("Незакрытая кавычка в поле CSV");
+            }
+            scratch_.append(line.data() + i, quote - i);
+            if (quote + 1 < line.size() && line[quote + 1] == '"') {
+                scratch_ += '"';
+                i = quote + 2;
+                continue;
+            }
+            fields_.emplace_back(scratch_.data() + start, scratch_.size() - start);
+            return line.find(delimiter_, quote + 1);
+        }
+    }
+
+    // Поле TSV с escape-последовательностями; \N означает NULL
+    string_view unescape(string_view raw) {
+        size_t start = scratch_.size();
+        for (size_t i = 0; i < raw.size(); ++i) {
+            char c = raw[i];
+            if (c != '\\' || i + 1 == raw.size()) {
+                scratch_ += c;
+                continue;
+            }
+            switch (raw[++i]) {
+                case 't': scratch_ += '\t'; break;
+                case 'n': scratch_ += '\n'; break;
+                case 'r': scratch_ += '\r'; break;
+                case '0': scratch_ += '\0'; break;
+                case 'N': break;
+                default: scratch_ += raw[i]; break;
+            }
+        }
+        return string_view(scratch_.data() + start, scratch_.size() - start);
+    }
+
+    InputSource& source_;
+    const TblCol& columns_;
+    char delimiter_;
+    bool tsv_;
+    vector<int> mapping_;
+    vector<string_view> fields_;
+    string scratch_;
+};
+
+struct StringViewHash {
+    using is_transparent = void;
+    size_t operator()(string_view s) const {
+        return hash<string_view>{}(s);
+    }
+};
+
+// JSON Lines: один плоский объект на строку, ключи — имена столбцов
+class JsonLinesReader : public RecordReader {
+public:
+    JsonLinesReader(InputSource& source, const TblCol& columns) : source_(source), columns_(columns) {
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            index_.emplace(columns_[i].first, i);
+        }
+    }
+
+    bool next(vector<string_view>& values) override {
+        values.assign(columns_.size(), string_view());
+        return parseObject([&](string_view key, string_view value) {
+            auto it = index_.find(key);
+            if (it != index_.end()) {
+                values[it->second] = value;
+            }
+        });
+    }
+
+    // Все пары ключ-значение очередного объекта, без сопоставления со столбцами
+    bool nextObject(vector<pair<string_view, string_view>>& fields) {
+        fields.clear();
+        return parseObject([&](string_view key, string_view value) { fields.emplace_back(key, value); });
+    }
+
+private:
+    template <typename OnField>
+    bool parseObject(OnField&& onField) {
+        if (!nextLine(source_, line_, false)) {
+            return false;
+        }
+        pos_ = 0;
+        scratch_.clear();
+        scratch_.reserve(line_.size());
+
+        skipSpaces();
+        expect('{');
+        skipSpaces();
+        if (peek() == '}') {
+            return true;
+        }
+        while (true) {
+            skipSpaces();
+            string_view key = parseString();
+            skipSpaces();
+            expect(':');
+            skipSpaces();
+            string_view value = parseValue();
+            onField(key, value);
+            skipSpaces();
+            if (peek() == ',') {
+                ++pos_;
+                continue;
+            }
+            expect('}');
+            return true;
+        }
+    }
+
+    char peek() const {
+        return pos_ < line_.size() ? line_[pos_] : '\0';
+    }
+
+    void skipSpaces() {
+        while (pos_ < line_.size() && isspace(static_cast<unsigned char>(line_[pos_]))) {
+            ++pos_;
+        }
+    }
+
+    void expect(char c) {
+        if (peek() != c) {
+            throw invalid_argument(string("Ошибка разбора JSON: ожидался символ '") + c + "' в позиции " +
+                                   to_string(pos_));
+        }
+        ++pos_;
+    }
+
+    void appendUtf8(uint32_t cp) {
+        if (cp < 0x80) {
+            scratch_ += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            scratch_ += static_cast<char>(0xC0 | (cp >> 6));
+            scratch_ += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            scratch_ += static_cast<char>(0xE0 | (cp >> 12));
+            scratch_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            scratch_ += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            scratch_ += static_cast<char>(0xF0 | (cp >> 18));
+            scratch_ += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            scratch_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            scratch_ += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    uint32_t parseHex4() {
+        uint32_t cp = 0;
+        if (pos_ + 4 > line_.size() ||
+            from_chars(line_.data() + pos_, line_.data() + pos_ + 4, cp, 16).ptr != line_.data() + pos_ + 4) {
+            throw invalid_argument("Ошибка разбора JSON: неверная escape-последовательность \\u");
+        }
+        pos_ += 4;
+        return cp;
+    }
+
+    // Строка без escape-последовательностей возвращается как представление во входной буфер
+    string_view parseString() {
+        expect('"');
+        size_t start = pos_;
+        while (pos_ < line_.size() && line_[pos_] != '"' && line_[pos_] != '\\') {
+            ++pos_;
+        }
+        if (peek() == '"') {
+            ++pos_;
+            return line_.substr(start, pos_ - start - 1);
+        }
+
+        size_t out = scratch_.size();
+        scratch_.append(line_.data() + start, pos_ - start);
+        while (pos_ < line_.size() && line_[pos_] != '"') {
+            char c = line_[pos_++];
+            if (c != '\\') {
+                scratch_ += c;
+                continue;
+            }
+            char e = peek();
+            ++pos_;
+            switch (e) {
+                case 'n': scratch_ += '\n'; break;
+                case 't': scratch_ += '\t'; break;
+                case 'r': scratch_ += '\r'; break;
+                case 'b': scratch_ += '\b'; break;
+                case 'f': scratch_ += '\f'; break;
+                case 'u': {
+                    uint32_t cp = parseHex4();
+                    if (cp >= 0xD800 && cp < 0xDC00 && line_.substr(pos_, 2) == "\\u") {
+                        pos_ += 2;
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (parseHex4() - 0xDC00);
+                    }
+                    appendUtf8(cp);
+                    break;
+                }
+                default: scratch_ += e; break;
+            }
+        }
+        expect('"');
+        return string_view(scratch_.data() + out, scratch_.size() - out);
+    }
+
+    // Значение столбца: строка, число, true/false (как 1/0) или null (как пустое значение)
+    string_view parseValue() {
+        if (peek() == '"') {
+            return parseString();
+        }
+        size_t start = pos_;
+        while (pos_ < line_.size() && line_[pos_] != ',' && line_[pos_] != '}' &&
+               !isspace(static_cast<unsigned char>(line_[pos_]))) {
+            ++pos_;
+        }
+        string_view token = line_.substr(start, pos_ - start);
+        if (token == "null") {
+            return string_view();
+        }
+        if (token == "true") {
+            return "1";
+        }
+        if (token == "false") {
+            return "0";
+        }
+        if (token.empty()) {
+            throw invalid_argument("Ошибка разбора JSON: пустое значение в позиции " + to_string(start));
+        }
+        return token;
+    }
+
+    InputSource& source_;
+    const TblCol& columns_;
+    unordered_map<string, size_t, StringViewHash, equal_to<>> index_;
+    string_view line_;
+    size_t pos_ = 0;
+    string scratch_;
+};
+
+inline unique_ptr<RecordReader> makeReader(InputSource& source, const TblCol& columns, const IngestOptions& options) {
+    if (options.format == IngestFormat::JsonLines) {
+        return make_unique<JsonLinesReader>(source, columns);
+    }
+    return make_unique<DelimitedReader>(source, columns, options.format, options.header);
+}
+
+// Смещение для значений DateTime64 без явного часового пояса: +03:00, -0500, Z
+inline void setInputTimezone(const string& tz) {
+    int64_t ticks = 0;
+    if (!parseDateTime64("1970-01-01 00:00:00" + tz, 0, ticks)) {
+        throw invalid_argument("Неверное смещение часового пояса: " + tz);
+    }
+    inputUtcOffsetSeconds = static_cast<int32_t>(-ticks);
+}
+
+// Разбор аргументов: ingest <таблица> [файл|-] [--format csv|tsv|jsonl] [--header]
+//                    [--batch-rows N] [--batch-bytes N] [--batch-ms N] [--tz ±HH:MM] [--parsers N] [--inserters N]
+//                    [--spool DIR] [--sort-by СТОЛБЕЦ | --no-sort] [--no-split] [--buffer-bytes N]
+//                    [--metrics-port PORT] [--metrics-file PATH] [--trace PATH]
+//           ingest --route [файл|-] [--by ПОЛЕ] [--map ЗНАЧЕНИЕ=ТАБЛИЦА]... [параметры загрузки]
+//           listen [--udp PORT] [--tcp PORT] [--bind ADDR] [--by ПОЛЕ] [--map ЗНАЧЕНИЕ=ТАБЛИЦА]... [параметры загрузки]
+//           [--tz ±HH:MM] (без режима — интерактивная вставка одной строки)
+// Время без явного часового пояса считается UTC (раньше — местным временем машины); --tz задаёт другое смещение.
+// При маршрутизации по числовому полю (msgtype по умолчанию) --map обязателен: без правил значение
+// понимается как имя таблицы (t_ можно опускать), что годится только для строкового поля или поля JSON вне схем.
+inline IngestOptions parseIngestArgs(const vector<string>& args) {
+    IngestOptions options;
+    vector<string> positional;
+    for (size_t i = 0; i < args.size(); ++i) {
+        const string& arg = args[i];
+        auto value = [&]() -> const string& {
+            if (i + 1 >= args.size()) {
+                throw invalid_argument("Для параметра " + arg + " не указано значение");
+            }
+            return args[++i];
+        };
+        if (arg == "--format") {
+            const string& format = value();
+            if (format == "csv") {
+                options.format = IngestFormat::Csv;
+            } else if (format == "tsv") {
+                options.format = IngestFormat::Tsv;
+            } else if (format == "jsonl") {
+                options.format = IngestFormat::JsonLines;
+            } else {
+                throw invalid_argument("Неизвестный формат: " + format);
+            }
+        } else if (arg == "--header") {
+            options.header = true;
+        } else if (arg == "--batch-rows") {
+            options.limits.maxRows = stoull(value());
+        } else if (arg == "--batch-bytes") {
+            options.limits.maxBytes = stoull(value());
+        } else if (arg == "--batch-ms") {
+            options.limits.maxAge = chrono::milliseconds(stoll(value()));
+        } else if (arg == "--sort-by") {
+            options.limits.sortColumn = value();
+        } else if (arg == "--no-sort") {
+            options.limits.sortColumn.clear();
+        } else if (arg == "--no-split") {
+            options.splitPartitions = false;
+        } else if (arg == "--buffer-bytes") {
+            options.limits.maxBufferedBytes = stoull(value());
+        } else if (arg == "--tz") {
+            setInputTimezone(value());
+        } else if (arg == "--parsers") {
+            options.parsers = max<size_t>(1, stoull(value()));
+        } else if (arg == "--inserters") {
+            options.inserters = max<size_t>(1, stoull(value()));
+        } else if (arg == "--spool") {
+            options.spoolDir = value();
+        } else if (arg == "--metrics-port") {
+            options.metricsPort = static_cast<uint16_t>(stoul(value()));
+        } else if (arg == "--metrics-file") {
+            options.metricsFile = value();
+        } else if (arg == "--trace") {
+            options.tracePath = value();
+        } else if (arg == "--udp") {
+            options.udpPort = static_cast<uint16_t>(stoul(value()));
+        } else if (arg == "--tcp") {
+            options.tcpPort = static_cast<uint16_t>(stoul(value()));
+        } else if (arg == "--bind") {
+            options.listenAddress = value();
+        } else if (arg == "--route") {
+            options.route = true;
+        } else if (arg == "--by") {
+            options.discriminator = value();
+        } else if (arg == "--map") {
+            // Значение поля-дискриминатора и таблица: --map 17=t_hostattack
+            const string& route = value();
+            size_t eq = route.find('=');
+            if (eq == string::npos || eq == 0 || eq + 1 == route.size()) {
+                throw invalid_argument("Неверное правило маршрутизации: " + route + " (ожидается ЗНАЧЕНИЕ=ТАБЛИЦА)");
+            }
+            options.routes.emplace_back(route.substr(0, eq), route.substr(eq + 1));
+        } else if (arg.starts_with("--")) {
+            throw invalid_argument("Неизвестный параметр: " + arg);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (options.route) {
+        // Таблица определяется для каждой записи, поэтому позиционный аргумент только один — файл
+        if (positional.size() > 1) {
+            throw invalid_argument("Использование: ingest --route [файл|-] [--by ПОЛЕ] [--map ЗНАЧЕНИЕ=ТАБЛИЦА]... "
+                                   "[--format csv|tsv|jsonl] [--batch-rows N] [--batch-bytes N] [--batch-ms N] "
+                                   "[--tz ±HH:MM] [--inserters N] [--spool DIR]");
+        }
+        if (!positional.empty()) {
+            options.path = positional[0];
+        }
+        return options;
+    }
+    if (positional.empty() || positional.size() > 2) {
+        throw invalid_argument("Использование: ingest <таблица> [файл|-] [--format csv|tsv|jsonl] [--header] "
+                               "[--batch-rows N] [--batch-bytes N] [--batch-ms N] [--tz ±HH:MM] [--parsers N] [--inserters N] [--spool DIR]");
+    }
+    options.table = positional[0];
+    if (positional.size() == 2) {
+        options.path = positional[1];
+    }
+    return options;
+}
+
+// Потоковая загрузка файла в таблицу пакетами нативного формата; при заданном спуле пакеты,
+// которые не удалось вставить, сохраняются на диск
+inline int runIngest(ConnectionPool& pool, const TblCol& columns, const IngestOptions& options, Spool* spool = nullptr) {
+    size_t rows = 0;
+    size_t errors = 0;
+    auto started = chrono::steady_clock::now();
+
+    try {
+        unique_ptr<InputSource> source = openInput(options.path);
+        unique_ptr<RecordReader> reader = makeReader(*source, columns, options);
+        TableBatcher batcher(options.table, columns, options.limits, [&](const string& table, const Block& block) {
+            insertOrSpool(pool, spool, table, columns, block);
+        }, partitionKeyFor(options, options.table, columns));
+
+        vector<string_view> values;
+        while (true) {
+            try {
+                if (!reader->next(values)) {
+                    break;
+                }
+                batcher.add(values);
+                ++rows;
+            } catch (const invalid_argument& e) {
+                if (++errors <= 10) {
+                    cerr << "Ошибка в записи " << rows + errors << ": " << e.what() << endl;
+                }
+            }
+        }
+        batcher.flush();
+    } catch (const exception& e) {
+        cerr << "Ошибка: " << e.what() << endl;
+        return 1;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    cout << "Загружено строк: " << rows << ", пропущено с ошибками: " << errors << ", время: " << seconds
+         << " с, скорость: " << static_cast<size_t>(seconds > 0 ? rows / seconds : 0) << " строк/с." << endl;
+    return errors == 0 ? 0 : 2;
+}
+
+#endif // INGEST_H
@@ -0,0 +1,700 @@
+#ifndef INSERT_H
+#define INSERT_H
+
+#include <arpa/inet.h>
+#include <clickhouse/base/output.h>
+#include <clickhouse/client.h>
+#include <cityhash/city.h>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include "arena.h"
+#include "datetime.h"
+#include "integers.h"
+#include "ip.h"
+#include "metrics.h"
+#include "schemas.h"
+#include "server_stats.h"
+#include "sort.h"
+#include "trace.h"
+#include "types.h"
+
+using namespace clickhouse;
+using namespace std;
+
+// Значение, разобранное до записи в столбец. Строка сначала разбирается целиком и только потом
+// пишется в столбцы, поэтому отклонённая строка не оставляет в них следов
+struct StagedValue {
+    string_view text;
+    uint64_t number = 0;
+    int64_t ticks = 0;
+    array<uint8_t, 16> address{};
+    bool isNull = false;
+};
+
+// Операции над столбцом одного базового типа; выбираются по BaseType через таблицу переходов
+struct ColumnOps {
+    ColumnRef (*create)(const TypeDesc& desc);
+    // Разбор текстового значения; при ошибке бросает исключение, столбец не меняется
+    void (*parse)(const Column& column, string_view value, StagedValue& out);
+    // Запись разобранного значения; ошибкой может быть только нехватка памяти
+    void (*store)(Column& column, const StagedValue& value, StringArena& arena);
+    void (*appendDefault)(Column& column);
+    // Текстовое представление значения, которое append разбирает обратно без потерь
+    void (*format)(const Column& column, size_t row, string& out);
+    // Копирование значения строки row из столбца того же типа; строки остаются в арене исходного пакета
+    void (*copy)(Column& column, const Column& from, size_t row);
+    // Разбор целого столбца значений (только UInt): индекс первого ошибочного значения или values.size()
+    size_t (*parseColumn)(span<const string_view> values, uint64_t* out, uint8_t* nulls, ConvertError& error);
+};
+
+template <typename T>
+inline ColumnOps uintOps() {
+    return {
+        [](const TypeDesc&) -> ColumnRef { return make_shared<ColumnVector<T>>(); },
+        [](const Column&, string_view value, StagedValue& out) {
+            T parsed = 0;
+            ConvertError error = parseUInt(value, parsed);
+            if (error != ConvertError::None) {
+                throw invalid_argument(convertErrorText(error));
+            }
+            out.number = parsed;
+        },
+        [](Column& column, const StagedValue& value, StringArena&) {
+            static_cast<ColumnVector<T>&>(column).Append(static_cast<T>(value.number));
+        },
+        [](Column& column) { static_cast<ColumnVector<T>&>(column).Append(0); },
+        [](const Column& column, size_t row, string& out) {
+            char buffer[24];
+            auto result = to_chars(buffer, buffer + sizeof(buffer), static_cast<const ColumnVector<T>&>(column).At(row));
+            out.append(buffer, result.ptr);
+        },
+        [](Column& column, const Column& from, size_t row) {
+            static_cast<ColumnVector<T>&>(column).Append(static_cast<const ColumnVector<T>&>(from).At(row));
+        },
+        // Блоками по 256 значений во временный массив ширины столбца, чтобы проверка диапазона была точной
+        [](span<const string_view> values, uint64_t* out, uint8_t* nulls, ConvertError& error) -> size_t {
+            T block[256];
+            error = ConvertError::None;
+            for (size_t start = 0; start < values.size(); start += size(block)) {
+                span<const string_view> part = values.subspan(start, min(size(block), values.size() - start));
+                size_t parsed = parseUIntColumn(part, block, nulls ? nulls + start : nullptr, error);
+                copy(block, block + parsed, out + start);
+                if (parsed < part.size()) {
+                    return start + parsed;
+                }
+            }
+            return values.size();
+        },
+    };
+}
+
+inline const array<ColumnOps, kBaseTypeCount>& columnOps() {
+    static const array<ColumnOps, kBaseTypeCount> ops = {
+        // Unknown
+        ColumnOps{nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+        uintOps<uint8_t>(),
+        uintOps<uint16_t>(),
+        uintOps<uint32_t>(),
+        uintOps<uint64_t>(),
+        // String
+        ColumnOps{
+            [](const TypeDesc&) -> ColumnRef { return make_shared<ColumnString>(); },
+            // Строки лежат в арене пакета, столбец хранит только представления
+            [](const Column&, string_view, StagedValue&) {},
+            [](Column& column, const StagedValue& value, StringArena& arena) {
+                static_cast<ColumnString&>(column).AppendNoManagedLifetime(arena.copy(value.text));
+            },
+            [](Column& column) { static_cast<ColumnString&>(column).AppendNoManagedLifetime(string_view()); },
+            [](const Column& column, size_t row, string& out) { out += static_cast<const ColumnString&>(column).At(row); },
+            [](Column& column, const Column& from, size_t row) {
+                static_cast<ColumnString&>(column).AppendNoManagedLifetime(static_cast<const ColumnString&>(from).At(row));
+            },
+            nullptr,
+        },
+        // IPv4
+        ColumnOps{
+            [](const TypeDesc&) -> ColumnRef { return make_shared<ColumnIPv4>(); },
+            [](const Column&, string_view value, StagedValue& out) {
+                uint32_t address = 0;
+                if (!parseIPv4(value, address)) {
+                    throw invalid_argument("Неверный адрес IPv4");
+                }
+                out.number = address;
+            },
+            [](Column& column, const StagedValue& value, StringArena&) {
+                static_cast<ColumnIPv4&>(column).Append(in_addr{htonl(static_cast<uint32_t>(value.number))});
+            },
+            [](Column& column) { static_cast<ColumnIPv4&>(column).Append(in_addr{}); },
+            [](const Column& column, size_t row, string& out) {
+                char buffer[INET_ADDRSTRLEN];
+                in_addr address = static_cast<const ColumnIPv4&>(column).At(row);
+                out += inet_ntop(AF_INET, &address, buffer, sizeof(buffer));
+            },
+            [](Column& column, const Column& from, size_t row) {
+                static_cast<ColumnIPv4&>(column).Append(static_cast<const ColumnIPv4&>(from).At(row));
+            },
+            nullptr,
+        },
+        // IPv6
+        ColumnOps{
+            [](const TypeDesc&) -> ColumnRef { return make_shared<ColumnIPv6>(); },
+            [](const Column&, string_view value, StagedValue& out) {
+                if (!parseIPv6(value, out.address)) {
+                    throw invalid_argument("Неверный адрес IPv6");
+                }
+            },
+            [](Column& column, const StagedValue& value, StringArena&) {
+                in6_addr address;
+                memcpy(&address, value.address.data(), value.address.size());
+                static_cast<ColumnIPv6&>(column).Append(&address);
+            },
+            [](Column& column) { static_cast<ColumnIPv6&>(column).Append(&in6addr_any); },
+            [](const Column& column, size_t row, string& out) {
+                char buffer[INET6_ADDRSTRLEN];
+                in6_addr address = static_cast<const ColumnIPv6&>(column).At(row);
+                out += inet_ntop(AF_INET6, &address, buffer, sizeof(buffer));
+            },
+            [](Column& column, const Column& from, size_t row) {
+                in6_addr address = static_cast<const ColumnIPv6&>(from).At(row);
+                static_cast<ColumnIPv6&>(column).Append(&address);
+            },
+            nullptr,
+        },
+        // DateTime64
+        ColumnOps{
+            [](const TypeDesc& desc) -> ColumnRef {
+                if (desc.timezone.empty()) {
+                    return make_shared<ColumnDateTime64>(desc.precision);
+                }
+                return make_shared<ColumnDateTime64>(desc.precision, string(desc.timezone));
+            },
+            [](const Column& column, string_view value, StagedValue& out) {
+                auto& dateTime = static_cast<const ColumnDateTime64&>(column);
+                if (!parseDateTime64(value, static_cast<unsigned>(dateTime.GetPrecision()), out.ticks)) {
+                    throw invalid_argument("Неверный формат даты и времени для значения " + string(value) +
+                                           ". Ожидаемый формат: YYYY-MM-DD HH:MM:SS[.fff]");
+                }
+            },
+            [](Column& column, const StagedValue& value, StringArena&) {
+                static_cast<ColumnDateTime64&>(column).Append(value.ticks);
+            },
+            [](Column& column) { static_cast<ColumnDateTime64&>(column).Append(0); },
+            // Явный суффикс Z: значение не зависит от --tz при повторном разборе
+            [](const Column& column, size_t row, string& out) {
+                auto& dateTime = static_cast<const ColumnDateTime64&>(column);
+                char buffer[32];
+                size_t length = formatDateTime64(dateTime.At(row), static_cast<unsigned>(dateTime.GetPrecision()), buffer);
+                out.append(buffer, length);
+                out += 'Z';
+            },
+            [](Column& column, const Column& from, size_t row) {
+                static_cast<ColumnDateTime64&>(column).Append(static_cast<const ColumnDateTime64&>(from).At(row));
+            },
+            nullptr,
+        },
+    };
+    return ops;
+}
+
+using ColumnLowCardinalityString = ColumnLowCardinalityT<ColumnString>;
+using ColumnLowCardinalityNullableString = ColumnLowCardinalityT<ColumnNullableT<ColumnString>>;
+
+// Столбец строк со словарным кодированием на стороне клиента
+inline ColumnRef createLowCardinalityColumn(bool nullable) {
+    if (nullable) {
+        return make_shared<ColumnLowCardinalityNullableString>();
+    }
+    return make_shared<ColumnLowCardinalityString>();
+}
+
+// Создание пустого столбца clickhouse-cpp по интернированному типу; typeText — тип столбца как в схеме
+inline ColumnRef createColumn(TypeId type, const string& typeText) {
+    const TypeDesc& desc = typeDesc(type);
+    const ColumnOps& ops = columnOps()[static_cast<size_t>(desc.base)];
+    if (desc.lowCardinality && desc.base == BaseType::String) {
+        return createLowCardinalityColumn(desc.nullable);
+    }
+    if (!ops.create || desc.lowCardinality || (desc.base == BaseType::DateTime64 && desc.precision > 9)) {
+        throw invalid_argument("Неподдерживаемый тип столбца: " + typeText);
+    }
+    ColumnRef column = ops.create(desc);
+    if (desc.nullable) {
+        return make_shared<ColumnNullable>(column, make_shared<ColumnUInt8>());
+    }
+    return column;
+}
+
+// Готовый пакет: блок и арена, которой принадлежат байты его строковых столбцов.
+// Арена должна жить, пока блок не отправлен.
+struct Batch {
+    Block block;
+    unique_ptr<StringArena> arena;
+
+    size_t rows() const {
+        return block.GetRowCount();
+    }
+};
+
+// Значение строки блока в текстовом виде; false для NULL. Понимает и словарные столбцы построителя.
+inline bool formatValue(const Column& column, TypeId type, size_t row, string& out) {
+    if (auto lc = dynamic_cast<const ColumnLowCardinalityNullableString*>(&column)) {
+        optional<string_view> value = lc->At(row);
+        if (value) {
+            out += *value;
+        }
+        return value.has_value();
+    }
+    if (auto lc = dynamic_cast<const ColumnLowCardinalityString*>(&column)) {
+        out += lc->At(row);
+        return true;
+    }
+    const ColumnOps& ops = columnOps()[static_cast<size_t>(typeDesc(type).base)];
+    if (auto nullable = dynamic_cast<const ColumnNullable*>(&column)) {
+        if (nullable->IsNull(row)) {
+            return false;
+        }
+        ops.format(*nullable->Nested(), row, out);
+        return true;
+    }
+    ops.format(column, row, out);
+    return true;
+}
+
+// Состояние словарного кодирования строкового столбца; живёт в построителе и переживает пакеты.
+// Пока столбец передаётся как обычный String, запоминаются хеши его значений; если различных значений
+// мало, следующие пакеты кодируются как LowCardinality. Сервер приводит такой столбец к типу таблицы.
+struct DictionaryState {
+    static constexpr size_t kMaxDistinct = 1024;
+    static constexpr size_t kMinRows = 1024;
+    static constexpr size_t kRecheckBatches = 64;
+
+    bool lowCardinality = false;
+    bool tracking = true;
+    unordered_set<size_t> distinct;
+    size_t rows = 0;
+    size_t batchesSinceCheck = 0;
+
+    void observe(string_view value) {
+        if (distinct.insert(hash<string_view>{}(value)).second && distinct.size() > kMaxDistinct) {
+            // Столбец с высокой кардинальностью: не тратим время на хеширование до следующей проверки
+            tracking = false;
+            distinct.clear();
+        }
+        ++rows;
+    }
+
+    // Решение о кодировании следующего пакета по итогам текущего
+    void finishBatch(size_t dictionarySize) {
+        if (lowCardinality) {
+            if (dictionarySize > kMaxDistinct) {
+                lowCardinality = false;
+                tracking = false;
+                batchesSinceCheck = 0;
+            }
+            return;
+        }
+        if (tracking) {
+            if (rows >= kMinRows && distinct.size() * 8 <= rows) {
+                lowCardinality = true;
+                distinct.clear();
+            }
+            return;
+        }
+        if (++batchesSinceCheck >= kRecheckBatches) {
+            tracking = true;
+            rows = 0;
+            batchesSinceCheck = 0;
+        }
+    }
+};
+
+// Построитель блока в нативном формате: значения сразу пишутся в типизированные столбцы
+class BlockBuilder {
+public:
+    explicit BlockBuilder(const TblCol& columns)
+        : columns_(columns), staged_(columns.size()), converted_(columns.size()), dictionaries_(columns.size()) {
+        for (const auto& col : columns_) {
+            types_.push_back(internType(col.second));
+        }
+        for (size_t i = 0; i < types_.size(); ++i) {
+            const TypeDesc& desc = typeDesc(types_[i]);
+            if (desc.base == BaseType::String) {
+                dictionaries_[i] = make_unique<DictionaryState>();
+                dictionaries_[i]->lowCardinality = desc.lowCardinality;
+            }
+        }
+        reset();
+    }
+
+    // Добавление строки из vector<string> или vector<string_view>. Все значения разбираются до записи
+    // в столбцы, поэтому при ошибке преобразования блок остаётся в прежнем состоянии без лишней работы.
+    // Время преобразования замеряется у каждой 64-й строки потока: замер каждой стоил бы дороже самой строки
+    template <typename Values>
+    void appendRow(const Values& values) {
+        thread_local uint32_t sample = 0;
+        bool timed = metricsEnabled.load(memory_order_relaxed) && (++sample & 63) == 0;
+        chrono::steady_clock::time_point started;
+        if (timed) {
+            started = chrono::steady_clock::now();
+        }
+        if (values.size() != columns_.size()) {
+            throw invalid_argument("Количество значений (" + to_string(values.size()) +
+                                   ") не совпадает с количеством столбцов (" + to_string(columns_.size()) + ")");
+        }
+
+        size_t i = 0;
+        try {
+            for (; i < slots_.size(); ++i) {
+                stage(i, values[i]);
+            }
+        } catch (const exception& e) {
+            throw invalid_argument(valueError(i, values[i], e.what()));
+        }
+        commitRow();
+        if (timed) {
+            recordLatency(Stage::Convert, chrono::steady_clock::now() - started);
+        }
+    }
+
+    // Пакетное добавление строк: values содержит строки подряд, по columns().size() значений на строку.
+    // Столбцы UInt преобразуются целиком через parseUIntColumn, остальные значения — построчно, как в appendRow.
+    // Строки до первой ошибочной добавляются, затем бросается invalid_argument.
+    void appendRows(span<const string_view> values) {
+        size_t width = columns_.size();
+        if (width == 0 || values.size() % width != 0) {
+            throw invalid_argument("Количество значений (" + to_string(values.size()) +
+                                   ") не кратно количеству столбцов (" + to_string(width) + ")");
+        }
+        size_t count = values.size() / width;
+        size_t limit = count;
+        size_t failedColumn = 0;
+        ConvertError failure = ConvertError::None;
+        for (size_t i = 0; i < width; ++i) {
+            const Slot& slot = slots_[i];
+            ConvertedColumn& converted = converted_[i];
+            converted.active = slot.ops->parseColumn && !slot.lowCardinality;
+            if (!converted.active) {
+                continue;
+            }
+            columnValues_.resize(count);
+            for (size_t row = 0; row < count; ++row) {
+                columnValues_[row] = values[row * width + i];
+            }
+            converted.numbers.resize(count);
+            converted.nulls.assign(count, 0);
+            ConvertError error = ConvertError::None;
+            size_t failed = slot.ops->parseColumn(columnValues_, converted.numbers.data(),
+                                                  slot.nulls ? converted.nulls.data() : nullptr, error);
+            if (failed < limit) {
+                limit = failed;
+                failedColumn = i;
+                failure = error;
+            }
+        }
+
+        for (size_t row = 0; row < limit; ++row) {
+            span<const string_view> rowValues = values.subspan(row * width, width);
+            size_t i = 0;
+            try {
+                for (; i < width; ++i) {
+                    const ConvertedColumn& converted = converted_[i];
+                    if (converted.active) {
+                        StagedValue& staged = staged_[i];
+                        staged.text = rowValues[i];
+                        staged.isNull = converted.nulls[row];
+                        staged.number = converted.numbers[row];
+                    } else {
+                        stage(i, rowValues[i]);
+                    }
+                }
+            } catch (const exception& e) {
+                throw invalid_argument(valueError(i, rowValues[i], e.what()));
+            }
+            commitRow();
+        }
+        if (limit < count) {
+            string_view value = values[limit * width + failedColumn];
+            throw invalid_argument(valueError(failedColumn, value, convertErrorText(failure)));
+        }
+    }
+
+    // Упорядочивание строк каждого пакета по столбцу DateTime64 (например, datetime из ORDER BY таблицы):
+    // сервер получает отсортированные части и тратит меньше работы на слияния. false, если столбца нет.
+    bool sortBy(string_view column) {
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            if (columns_[i].first == column && typeDesc(types_[i]).base == BaseType::DateTime64) {
+                sortColumn_ = static_cast<int>(i);
+                sortKeys_.reserve(1024);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t rows() const {
+        return rows_;
+    }
+
+    const TblCol& columns() const {
+        return columns_;
+    }
+
+    // Получение готового пакета; построитель начинает новый пустой блок с новой ареной
+    Batch build() {
+        StageTimer timer(Stage::Build);
+        TraceSpan span("build", {}, rows_);
+        if (sortColumn_ >= 0 && radixSortOrder(sortKeys_, order_)) {
+            permute();
+        }
+        Batch batch;
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            batch.block.AppendColumn(columns_[i].first, slots_[i].column);
+        }
+        batch.block.RefreshRowCount();
+        batch.arena = move(arena_);
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (DictionaryState* dictionary = slots_[i].dictionary) {
+                size_t dictionarySize = slots_[i].lowCardinality
+                    ? static_cast<ColumnLowCardinality&>(*slots_[i].data).GetDictionarySize()
+                    : 0;
+                if (!typeDesc(types_[i]).lowCardinality) {
+                    dictionary->finishBatch(dictionarySize);
+                }
+            }
+        }
+        reset();
+        return batch;
+    }
+
+private:
+    // Столбец UInt, преобразованный целиком в appendRows
+    struct ConvertedColumn {
+        bool active = false;
+        vector<uint64_t> numbers;
+        vector<uint8_t> nulls;
+    };
+
+    // Столбец блока с заранее разрешёнными операциями, чтобы не разбирать тип на каждое значение
+    struct Slot {
+        ColumnRef column;
+        Column* data = nullptr;
+        ColumnNullable* nulls = nullptr;
+        const ColumnOps* ops = nullptr;
+        DictionaryState* dictionary = nullptr;
+        bool lowCardinality = false;
+        bool nullable = false;
+    };
+
+    void bind(Slot& slot, size_t index) {
+        const TypeDesc& desc = typeDesc(types_[index]);
+        slot.ops = &columnOps()[static_cast<size_t>(desc.base)];
+        slot.dictionary = dictionaries_[index].get();
+        slot.lowCardinality = slot.dictionary && slot.dictionary->lowCardinality;
+        slot.nullable = desc.nullable;
+        slot.nulls = slot.lowCardinality ? nullptr : dynamic_cast<ColumnNullable*>(slot.column.get());
+        slot.data = slot.nulls ? slot.nulls->Nested().get() : slot.column.get();
+    }
+
+    string valueError(size_t i, string_view value, const char* reason) const {
+        return "Столбец " + columns_[i].first + " имеет неверный тип для значения " + string(value) +
+               ". Ожидаемый тип: " + columns_[i].second + ". " + reason;
+    }
+
+    void stage(size_t i, string_view value) {
+        const Slot& slot = slots_[i];
+        StagedValue& staged = staged_[i];
+        staged.text = value;
+        staged.isNull = slot.nulls && value.empty();
+        if (!slot.lowCardinality && !staged.isNull) {
+            slot.ops->parse(*slot.data, value, staged);
+        }
+    }
+
+    // Запись разобранной строки во все столбцы. Словарь наблюдает значения только принятых строк,
+    // чтобы отклонённые не искажали оценку кардинальности
+    void commitRow() {
+        try {
+            for (size_t i = 0; i < slots_.size(); ++i) {
+                const Slot& slot = slots_[i];
+                const StagedValue& staged = staged_[i];
+                if (slot.lowCardinality) {
+                    appendLowCardinality(slot, staged.text);
+                } else if (slot.nulls) {
+                    if (staged.isNull) {
+                        slot.ops->appendDefault(*slot.data);
+                    } else {
+                        slot.ops->store(*slot.data, staged, *arena_);
+                    }
+                    slot.nulls->Append(staged.isNull);
+                } else {
+                    slot.ops->store(*slot.data, staged, *arena_);
+                }
+            }
+        } catch (...) {
+            rollback();
+            throw;
+        }
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            const Slot& slot = slots_[i];
+            if (!slot.lowCardinality && slot.dictionary && slot.dictionary->tracking) {
+                slot.dictionary->observe(staged_[i].text);
+            }
+        }
+        if (sortColumn_ >= 0) {
+            sortKeys_.push_back(sortKey(slots_[static_cast<size_t>(sortColumn_)], rows_));
+        }
+        ++rows_;
+    }
+
+    // Значение словарного столбца: словарь пакета строит сам столбец, арена не нужна
+    static void appendLowCardinality(const Slot& slot, string_view value) {
+        if (slot.nullable) {
+            auto& column = static_cast<ColumnLowCardinalityNullableString&>(*slot.data);
+            column.Append(value.empty() ? optional<string_view>() : optional<string_view>(value));
+        } else {
+            static_cast<ColumnLowCardinalityString&>(*slot.data).Append(value);
+        }
+    }
+
+    static int64_t sortKey(const Slot& slot, size_t row) {
+        if (slot.nulls && slot.nulls->IsNull(row)) {
+            return INT64_MIN;
+        }
+        return static_cast<const ColumnDateTime64&>(*slot.data).At(row);
+    }
+
+    // Перестановка строк всех столбцов в порядке order_
+    void permute() {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            slots_[i] = rebuild(i, order_);
+        }
+    }
+
+    // Столбец i, собранный заново последовательным проходом по строкам rows исходного. Байты строк
+    // не копируются: новый столбец ссылается на ту же арену, поэтому исходный можно сразу освободить
+    template <typename Rows>
+    Slot rebuild(size_t i, const Rows& rows) {
+        const Slot& from = slots_[i];
+        Slot to;
+        to.column = from.lowCardinality ? createLowCardinalityColumn(from.nullable)
+                                        : createColumn(types_[i], columns_[i].second);
+        bind(to, i);
+        if (!to.lowCardinality) {
+            to.data->Reserve(rows.size());
+        }
+        for (auto row : rows) {
+            if (from.lowCardinality && from.nullable) {
+                static_cast<ColumnLowCardinalityNullableString&>(*to.data)
+                    .Append(static_cast<const ColumnLowCardinalityNullableString&>(*from.data).At(row));
+            } else if (from.lowCardinality) {
+                static_cast<ColumnLowCardinalityString&>(*to.data)
+                    .Append(static_cast<const ColumnLowCardinalityString&>(*from.data).At(row));
+            } else if (from.nulls) {
+                bool isNull = from.nulls->IsNull(row);
+                if (isNull) {
+                    to.ops->appendDefault(*to.data);
+                } else {
+                    to.ops->copy(*to.data, *from.data, row);
+                }
+                to.nulls->Append(isNull);
+            } else {
+                to.ops->copy(*to.data, *from.data, row);
+            }
+        }
+        return to;
+    }
+
+    void reset() {
+        sortKeys_.clear();
+        arena_ = make_unique<StringArena>();
+        slots_.assign(types_.size(), Slot{});
+        for (size_t i = 0; i < types_.size(); ++i) {
+            const DictionaryState* dictionary = dictionaries_[i].get();
+            slots_[i].column = dictionary && dictionary->lowCardinality
+                ? createLowCardinalityColumn(typeDesc(types_[i]).nullable)
+                : createColumn(types_[i], columns_[i].second);
+            bind(slots_[i], i);
+        }
+        rows_ = 0;
+    }
+
+    // Отбрасывание частично записанной строки после нехватки памяти: ошибки значений отсекает разбор
+    // до записи, поэтому пересборка столбцов на этом редком пути допустима. Slice здесь не годится:
+    // он копирует строки в память нового столбца, и после перестановки столбец ссылался бы на
+    // уже освобождённый срез
+    void rollback() {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (slots_[i].column->Size() > rows_) {
+                slots_[i] = rebuild(i, views::iota(size_t{0}, rows_));
+            }
+        }
+    }
+
+    TblCol columns_;
+    vector<TypeId> types_;
+    vector<Slot> slots_;
+    vector<StagedValue> staged_;
+    vector<ConvertedColumn> converted_;
+    vector<string_view> columnValues_;
+    vector<unique_ptr<DictionaryState>> dictionaries_;
+    unique_ptr<StringArena> arena_;
+    size_t rows_ = 0;
+    int sortColumn_ = -1;
+    vector<int64_t> sortKeys_;
+    vector<uint32_t> order_;
+};
+
+// Детерминированный токен дедупликации пакета: CityHash128 по имени таблицы и нативному
+// представлению столбцов. Столбцы сериализуются по одному, поэтому буфер не превышает наибольший столбец.
+// В bytes, если задан, возвращается объём нативного представления блока.
+inline string deduplicationToken(const string& table_name, const Block& block, size_t* bytes = nullptr) {
+    uint128 hash = CityHash128(table_name.data(), table_name.size());
+    Buffer buffer;
+    for (size_t i = 0; i < block.GetColumnCount(); ++i) {
+        buffer.clear();
+        BufferOutput output(&buffer);
+        const string& name = block.GetColumnName(i);
+        output.Write(name.data(), name.size());
+        block[i]->Save(&output);
+        output.Flush();
+        if (bytes) {
+            *bytes += buffer.size();
+        }
+        hash = CityHash128WithSeed(reinterpret_cast<const char*>(buffer.data()), buffer.size(), hash);
+    }
+    char token[33];
+    snprintf(token, sizeof(token), "%016llx%016llx", static_cast<unsigned long long>(hash.first),
+             static_cast<unsigned long long>(hash.second));
+    return token;
+}
+
+// Вставка блока через нативный протокол с токеном дедупликации: повтор того же пакета после сбоя
+// сервер отбрасывает, а не записывает второй раз
+inline void insertBlock(Client& client, const string& table_name, const Block& block, const string& token) {
+    TraceSpan span("insert", table_name, block.GetRowCount());
+    string query = "INSERT INTO `" + table_name + "` (";
+    for (size_t i = 0; i < block.GetColumnCount(); ++i) {
+        query += (i == 0 ? "`" : ", `") + block.GetColumnName(i) + "`";
+    }
+    query += ") VALUES";
+    Query insert(query);
+    insert.SetSetting("insert_deduplication_token", QuerySettingsField{token, QuerySettingsField::IMPORTANT});
+    ServerQuery stats(insert, metricsTable(table_name));
+    client.BeginInsert(insert);
+    client.SendInsertBlock(block);
+    client.EndInsert();
+}
+
+#endif // INSERT_H
@@ -0,0 +1,65 @@
+#ifndef INTEGERS_H
+#define INTEGERS_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+using namespace std;
+
+enum class ConvertError : uint8_t {
+    None,
+    Invalid,
+    Overflow,
+};
+
+// Разбор беззнакового целого ровно той ширины, что у столбца: 300 для UInt8 — переполнение, а не 44
+template <typename T>
+inline ConvertError parseUInt(string_view value, T& out) {
+    static_assert(is_unsigned_v<T>);
+    const char* end = value.data() + value.size();
+    auto [ptr, ec] = from_chars(value.data(), end, out);
+    if (ec == errc::result_out_of_range) {
+        return ConvertError::Overflow;
+    }
+    if (ec != errc() || ptr != end) {
+        return ConvertError::Invalid;
+    }
+    return ConvertError::None;
+}
+
+// Пакетное преобразование столбца значений. Пустое значение при nulls != nullptr — NULL (в out пишется 0).
+// Возвращает индекс первого ошибочного значения или values.size(), если ошибок нет.
+template <typename T>
+inline size_t parseUIntColumn(span<const string_view> values, T* out, uint8_t* nulls, ConvertError& error) {
+    error = ConvertError::None;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (nulls) {
+            bool isNull = values[i].empty();
+            nulls[i] = isNull;
+            if (isNull) {
+                out[i] = 0;
+                continue;
+            }
+        }
+        error = parseUInt(values[i], out[i]);
+        if (error != ConvertError::None) {
+            return i;
+        }
+    }
+    return values.size();
+}
+
+inline const char* convertErrorText(ConvertError error) {
+    switch (error) {
+        case ConvertError::None: return "нет ошибки";
+        case ConvertError::Invalid: return "значение не является беззнаковым целым";
+        case ConvertError::Overflow: return "значение выходит за пределы типа";
+    }
+    return "";
+}
+
+#endif // INTEGERS_H
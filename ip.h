@@ -0,0 +1,141 @@
+#ifndef IP_H
+#define IP_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+using namespace std;
+
+// Разбор IPv4 в точечной записи ("192.168.0.1") в число с порядком байт хоста.
+// Как и inet_pton, не допускает ведущих нулей и пустых октетов.
+inline bool parseIPv4(string_view s, uint32_t& address) {
+    uint32_t result = 0;
+    size_t pos = 0;
+    for (int octet = 0; octet < 4; ++octet) {
+        if (octet > 0) {
+            if (pos >= s.size() || s[pos] != '.') {
+                return false;
+            }
+            ++pos;
+        }
+        size_t start = pos;
+        unsigned value = 0;
+        while (pos < s.size() && pos - start < 3) {
+            unsigned d = static_cast<unsigned>(static_cast<unsigned char>(s[pos]) - '0');
+            if (d > 9) {
+                break;
+            }
+            value = value * 10 + d;
+            ++pos;
+        }
+        size_t digits = pos - start;
+        if (digits == 0 || value > 255 || (digits > 1 && s[start] == '0')) {
+            return false;
+        }
+        result = (result << 8) | value;
+    }
+    if (pos != s.size()) {
+        return false;
+    }
+    address = result;
+    return true;
+}
+
+inline int hexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c = static_cast<char>(c | 0x20);
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// Разбор IPv6 по RFC 4291/5952: сокращение "::", запись в любом регистре, IPv4 в последних 32 битах
+inline bool parseIPv6(string_view s, array<uint8_t, 16>& address) {
+    array<uint8_t, 16> bytes{};
+    size_t count = 0;
+    int gap = -1;
+    size_t pos = 0;
+
+    if (s.size() >= 2 && s[0] == ':' && s[1] == ':') {
+        gap = 0;
+        pos = 2;
+        if (pos == s.size()) {
+            address = bytes;
+            return true;
+        }
+    } else if (!s.empty() && s[0] == ':') {
+        return false;
+    }
+
+    while (pos < s.size()) {
+        size_t start = pos;
+        unsigned group = 0;
+        while (pos < s.size() && pos - start < 4) {
+            int d = hexDigit(s[pos]);
+            if (d < 0) {
+                break;
+            }
+            group = (group << 4) | static_cast<unsigned>(d);
+            ++pos;
+        }
+        if (pos < s.size() && s[pos] == '.') {
+            // Встроенный IPv4 занимает последние 4 байта
+            uint32_t v4 = 0;
+            if (count > 12 || !parseIPv4(s.substr(start), v4)) {
+                return false;
+            }
+            bytes[count++] = static_cast<uint8_t>(v4 >> 24);
+            bytes[count++] = static_cast<uint8_t>(v4 >> 16);
+            bytes[count++] = static_cast<uint8_t>(v4 >> 8);
+            bytes[count++] = static_cast<uint8_t>(v4);
+            pos = s.size();
+            break;
+        }
+        if (pos == start || count > 14) {
+            return false;
+        }
+        bytes[count++] = static_cast<uint8_t>(group >> 8);
+        bytes[count++] = static_cast<uint8_t>(group);
+
+        if (pos == s.size()) {
+            break;
+        }
+        if (s[pos] != ':') {
+            return false;
+        }
+        ++pos;
+        if (pos < s.size() && s[pos] == ':') {
+            if (gap >= 0) {
+                return false;
+            }
+            gap = static_cast<int>(count);
+            ++pos;
+            if (pos == s.size()) {
+                break;
+            }
+        } else if (pos == s.size()) {
+            return false;
+        }
+    }
+
+    if (gap >= 0) {
+        if (count == 16) {
+            return false;
+        }
+        size_t tail = count - static_cast<size_t>(gap);
+        memmove(bytes.data() + 16 - tail, bytes.data() + gap, tail);
+        memset(bytes.data() + gap, 0, 16 - count);
+    } else if (count != 16) {
+        return false;
+    }
+    address = bytes;
+    return true;
+}
+
+#endif // IP_H
@@ -0,0 +1,481 @@
+#ifndef LISTENER_H
+#define LISTENER_H
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ingest.h"
+#include "pipeline.h"
+#include "ring.h"
+#include "router.h"
+
+using namespace std;
+
+// Текст сообщения syslog без заголовка. RFC 5424: "<PRI>1 TIMESTAMP HOST APP PROCID MSGID SD MSG";
+// RFC 3164: "<PRI>Mmm dd hh:mm:ss HOST TAG: MSG". Строка без <PRI> возвращается как есть.
+inline string_view syslogMessage(string_view line) {
+    if (line.size() < 3 || line[0] != '<') {
+        return line;
+    }
+    size_t pos = line.find('>');
+    if (pos == string_view::npos || pos > 4) {
+        return line;
+    }
+    string_view rest = line.substr(pos + 1);
+
+    auto skipToken = [](string_view& s) {
+        size_t space = s.find(' ');
+        s = space == string_view::npos ? string_view() : s.substr(space + 1);
+    };
+
+    if (!rest.empty() && digit(rest[0]) < 10) {
+        // RFC 5424: версия и пять полей заголовка, затем структурированные данные
+        for (int i = 0; i < 6; ++i) {
+            skipToken(rest);
+        }
+        if (rest.starts_with("-")) {
+            rest.remove_prefix(1);
+        } else {
+            while (rest.starts_with("[")) {
+                size_t i = 1;
+                while (i < rest.size() && rest[i] != ']') {
+                    i += rest[i] == '\\' ? 2 : 1;
+                }
+                rest.remove_prefix(min(i + 1, rest.size()));
+            }
+        }
+        if (rest.starts_with(" ")) {
+            rest.remove_prefix(1);
+        }
+        if (rest.starts_with("\xEF\xBB\xBF")) {
+            rest.remove_prefix(3);
+        }
+        return rest;
+    }
+
+    // RFC 3164: метка времени фиксированной длины, имя узла и необязательный тег с двоеточием
+    if (rest.size() > 16 && rest[3] == ' ' && rest[6] == ' ' && rest[9] == ':' && rest[12] == ':' && rest[15] == ' ') {
+        rest.remove_prefix(16);
+        skipToken(rest);
+    }
+    size_t colon = rest.find(": ");
+    if (colon != string_view::npos && colon < 48 && rest.substr(0, colon).find(' ') == string_view::npos) {
+        rest.remove_prefix(colon + 2);
+    }
+    return rest;
+}
+
+// Признак остановки по SIGINT/SIGTERM
+inline atomic<bool> listenerStopRequested{false};
+
+extern "C" inline void onListenerSignal(int) {
+    listenerStopRequested.store(true);
+}
+
+// Счётчики приёмника
+struct ListenerStats {
+    atomic<size_t> datagrams{0};
+    atomic<size_t> frames{0};
+    atomic<size_t> connections{0};
+    atomic<size_t> kernelDrops{0};
+    atomic<size_t> rows{0};
+    atomic<size_t> errors{0};
+};
+
+// Приёмник syslog: UDP читается пачками через recvmmsg, TCP обслуживается циклом epoll с буфером
+// на соединение. Потоки приёма только выделяют текст сообщений и передают их пачками через кольцо
+// потокам разбора, поэтому медленная вставка не задерживает чтение из сокетов.
+class SyslogListener {
+public:
+    static constexpr size_t kBatchMessages = 64;
+    static constexpr size_t kMaxDatagram = 64 * 1024;
+    static constexpr size_t kMaxFrame = 1024 * 1024;
+    static constexpr int kReceiveBuffer = 64 * 1024 * 1024;
+
+    SyslogListener(EventRouter& router, const IngestOptions& options)
+        : router_(router), options_(options), chunks_(max<size_t>(options.parsers, 1) * 64) {}
+
+    SyslogListener(const SyslogListener&) = delete;
+    SyslogListener& operator=(const SyslogListener&) = delete;
+
+    ~SyslogListener() {
+        if (udp_ >= 0) {
+            ::close(udp_);
+        }
+        if (tcp_ >= 0) {
+            ::close(tcp_);
+        }
+    }
+
+    int run() {
+        try {
+            if (options_.udpPort) {
+                udp_ = openSocket(SOCK_DGRAM, options_.udpPort);
+            }
+            if (options_.tcpPort) {
+                tcp_ = openSocket(SOCK_STREAM, options_.tcpPort);
+            }
+        } catch (const exception& e) {
+            cerr << "Ошибка: " << e.what() << endl;
+            return 1;
+        }
+
+        struct sigaction action = {};
+        action.sa_handler = onListenerSignal;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+
+        vector<thread> workers;
+        for (size_t i = 0; i < max<size_t>(options_.parsers, 1); ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+        vector<thread> receivers;
+        if (udp_ >= 0) {
+            receivers.emplace_back([this] { guard([this] { udpLoop(); }); });
+        }
+        if (tcp_ >= 0) {
+            receivers.emplace_back([this] { guard([this] { tcpLoop(); }); });
+        }
+        cerr << "Приём syslog: UDP " << options_.udpPort << ", TCP " << options_.tcpPort << " на "
+             << options_.listenAddress << ". Остановка — SIGINT/SIGTERM." << endl;
+
+        auto reported = chrono::steady_clock::now();
+        while (!listenerStopRequested.load()) {
+            this_thread::sleep_for(chrono::milliseconds(200));
+            if (chrono::steady_clock::now() - reported >= chrono::seconds(10)) {
+                report();
+                reported = chrono::steady_clock::now();
+            }
+        }
+
+        for (auto& t : receivers) {
+            t.join();
+        }
+        chunks_.close();
+        for (auto& t : workers) {
+            t.join();
+        }
+        try {
+            router_.flush();
+        } catch (const exception& e) {
+            cerr << "Ошибка: " << e.what() << endl;
+        }
+        router_.printTables();
+        report();
+        router_.stop();
+        return failed_.load() ? 1 : 0;
+    }
+
+private:
+    int openSocket(int type, uint16_t port) {
+        int fd = ::socket(AF_INET, type | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            throw system_error(errno, generic_category(), "Не удалось создать сокет");
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        if (inet_pton(AF_INET, options_.listenAddress.c_str(), &address.sin_addr) != 1) {
+            ::close(fd);
+            throw invalid_argument("Неверный адрес для приёма: " + options_.listenAddress);
+        }
+        if (type == SOCK_DGRAM) {
+            // Большой приёмный буфер сглаживает всплески; SO_RCVBUFFORCE действует без ограничения rmem_max
+            int size = kReceiveBuffer;
+            if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0) {
+                setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+            }
+            setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+            timeval timeout = {0, 200000};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        }
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            (type == SOCK_STREAM && ::listen(fd, SOMAXCONN) != 0)) {
+            int err = errno;
+            ::close(fd);
+            throw system_error(err, generic_category(), "Не удалось открыть порт " + to_string(port));
+        }
+        if (type == SOCK_STREAM) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+        return fd;
+    }
+
+    template <typename Fn>
+    void guard(Fn&& fn) {
+        try {
+            fn();
+        } catch (const exception& e) {
+            cerr << "Ошибка приёма: " << e.what() << endl;
+            failed_ = true;
+            listenerStopRequested = true;
+        }
+    }
+
+    // Сообщение добавляется в пачку отдельной строкой: переводы строк внутри заменяются пробелами
+    static void appendMessage(string& chunk, string_view frame) {
+        while (!frame.empty() && (frame.back() == '\n' || frame.back() == '\r' || frame.back() == '\0')) {
+            frame.remove_suffix(1);
+        }
+        string_view message = syslogMessage(frame);
+        if (message.empty()) {
+            return;
+        }
+        size_t start = chunk.size();
+        chunk += message;
+        for (size_t i = start; i < chunk.size(); ++i) {
+            if (chunk[i] == '\n' || chunk[i] == '\r') {
+                chunk[i] = ' ';
+            }
+        }
+        chunk += '\n';
+    }
+
+    void udpLoop() {
+        vector<char> buffers(kBatchMessages * kMaxDatagram);
+        vector<iovec> iov(kBatchMessages);
+        vector<mmsghdr> messages(kBatchMessages);
+        constexpr size_t kControl = CMSG_SPACE(sizeof(uint32_t));
+        vector<char> control(kBatchMessages * kControl);
+        for (size_t i = 0; i < kBatchMessages; ++i) {
+            iov[i] = {buffers.data() + i * kMaxDatagram, kMaxDatagram};
+        }
+
+        while (!listenerStopRequested.load()) {
+            for (size_t i = 0; i < kBatchMessages; ++i) {
+                messages[i] = {};
+                messages[i].msg_hdr.msg_iov = &iov[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+                messages[i].msg_hdr.msg_control = control.data() + i * kControl;
+                messages[i].msg_hdr.msg_controllen = kControl;
+            }
+            int received = recvmmsg(udp_, messages.data(), kBatchMessages, MSG_WAITFORONE, nullptr);
+            if (received < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                    continue;
+                }
+                throw system_error(errno, generic_category(), "Ошибка recvmmsg");
+            }
+
+            Chunk chunk;
+            for (int i = 0; i < received; ++i) {
+                appendMessage(chunk.owned, string_view(static_cast<const char*>(iov[i].iov_base), messages[i].msg_len));
+                for (cmsghdr* cmsg = CMSG_FIRSTHDR(&messages[i].msg_hdr); cmsg;
+                     cmsg = CMSG_NXTHDR(&messages[i].msg_hdr, cmsg)) {
+                    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                        uint32_t drops = 0;
+                        memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                        stats_.kernelDrops.store(drops, memory_order_relaxed);
+                    }
+                }
+            }
+            stats_.datagrams.fetch_add(static_cast<size_t>(received), memory_order_relaxed);
+            if (!chunk.owned.empty()) {
+                chunks_.push(move(chunk));
+            }
+        }
+    }
+
+    struct Connection {
+        string buffer;
+    };
+
+    // Выделение кадров TCP: подсчёт октетов ("LEN MSG", RFC 6587) или завершение переводом строки
+    static void extractFrames(string& buffer, string& chunk, bool eof, size_t& frames) {
+        size_t pos = 0;
+        while (pos < buffer.size()) {
+            string_view rest = string_view(buffer).substr(pos);
+            if (digit(rest[0]) < 10) {
+                size_t length = 0;
+                size_t i = 0;
+                while (i < rest.size() && i < 8 && digit(rest[i]) < 10) {
+                    length = length * 10 + digit(rest[i++]);
+                }
+                if (i < rest.size() && rest[i] == ' ') {
+                    if (rest.size() - i - 1 < length) {
+                        break;
+                    }
+                    appendMessage(chunk, rest.substr(i + 1, length));
+                    pos += i + 1 + length;
+                    ++frames;
+                    continue;
+                }
+                if (i == rest.size() && !eof) {
+                    break;
+                }
+            }
+            size_t nl = rest.find('\n');
+            if (nl == string_view::npos) {
+                if (eof) {
+                    appendMessage(chunk, rest);
+                    pos = buffer.size();
+                    ++frames;
+                }
+                break;
+            }
+            appendMessage(chunk, rest.substr(0, nl));
+            pos += nl + 1;
+            ++frames;
+        }
+        buffer.erase(0, pos);
+    }
+
+    void tcpLoop() {
+        int epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll < 0) {
+            throw system_error(errno, generic_category(), "Ошибка epoll_create1");
+        }
+        unique_ptr<int, void (*)(int*)> epollGuard(&epoll, [](int* fd) { ::close(*fd); });
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = tcp_;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, tcp_, &event);
+
+        unordered_map<int, Connection> connections;
+        vector<epoll_event> events(256);
+        vector<char> buffer(256 * 1024);
+        auto closeConnection = [&](int fd) {
+            epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+            ::close(fd);
+            connections.erase(fd);
+        };
+
+        while (!listenerStopRequested.load()) {
+            int ready = epoll_wait(epoll, events.data(), static_cast<int>(events.size()), 200);
+            if (ready < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw system_error(errno, generic_category(), "Ошибка epoll_wait");
+            }
+
+            Chunk chunk;
+            size_t frames = 0;
+            for (int i = 0; i < ready; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == tcp_) {
+                    while (true) {
+                        int client = accept4(tcp_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                        if (client < 0) {
+                            break;
+                        }
+                        epoll_event clientEvent = {};
+                        clientEvent.events = EPOLLIN | EPOLLRDHUP;
+                        clientEvent.data.fd = client;
+                        epoll_ctl(epoll, EPOLL_CTL_ADD, client, &clientEvent);
+                        connections.emplace(client, Connection{});
+                        stats_.connections.fetch_add(1, memory_order_relaxed);
+                    }
+                    continue;
+                }
+
+                Connection& connection = connections[fd];
+                ssize_t n = ::read(fd, buffer.data(), buffer.size());
+                if (n > 0) {
+                    connection.buffer.append(buffer.data(), static_cast<size_t>(n));
+                    extractFrames(connection.buffer, chunk.owned, false, frames);
+                    if (connection.buffer.size() > kMaxFrame) {
+                        cerr << "Предупреждение: кадр TCP длиннее " << kMaxFrame << " байт, соединение закрыто." << endl;
+                        closeConnection(fd);
+                    }
+                } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    extractFrames(connection.buffer, chunk.owned, true, frames);
+                    closeConnection(fd);
+                }
+            }
+            stats_.frames.fetch_add(frames, memory_order_relaxed);
+            if (!chunk.owned.empty()) {
+                chunks_.push(move(chunk));
+            }
+        }
+        for (auto& [fd, connection] : connections) {
+            ::close(fd);
+        }
+    }
+
+    // Поток разбора: пачка сообщений читается тем же читателем, что и файл, и маршрутизируется по таблицам
+    void workerLoop() {
+        ChunkSource source;
+        vector<string_view> row;
+        Chunk chunk;
+        auto onError = [&](const exception& e) {
+            if (stats_.errors.fetch_add(1, memory_order_relaxed) < 10) {
+                cerr << "Ошибка в сообщении: " << e.what() << endl;
+            }
+        };
+        while (chunks_.pop(chunk)) {
+            source.reset(chunk.view());
+            try {
+                if (options_.format == IngestFormat::JsonLines) {
+                    JsonLinesReader reader(source, TblCol{});
+                    vector<pair<string_view, string_view>> fields;
+                    while (true) {
+                        try {
+                            if (!reader.nextObject(fields)) {
+                                break;
+                            }
+                            router_.route(fields, row);
+                            stats_.rows.fetch_add(1, memory_order_relaxed);
+                        } catch (const invalid_argument& e) {
+                            onError(e);
+                        }
+                    }
+                } else {
+                    DelimitedReader reader(source, TblCol{}, options_.format, false);
+                    vector<string_view> fields;
+                    while (true) {
+                        try {
+                            if (!reader.nextFields(fields)) {
+                                break;
+                            }
+                            router_.route(fields, row);
+                            stats_.rows.fetch_add(1, memory_order_relaxed);
+                        } catch (const invalid_argument& e) {
+                            onError(e);
+                        }
+                    }
+                }
+            } catch (const exception& e) {
+                // Ошибка вставки без спула: сообщения пачки теряются, приём продолжается
+                cerr << "Ошибка: " << e.what() << endl;
+            }
+        }
+    }
+
+    void report() {
+        cerr << "Приём: датаграмм " << stats_.datagrams.load() << ", кадров TCP " << stats_.frames.load()
+             << ", соединений " << stats_.connections.load() << ", потеряно ядром " << stats_.kernelDrops.load()
+             << ", строк " << stats_.rows.load() << ", ошибок " << stats_.errors.load() << ", пачек в очереди "
+             << chunks_.size() << "/" << chunks_.capacity() << endl;
+    }
+
+    EventRouter& router_;
+    const IngestOptions& options_;
+    BoundedRing<Chunk> chunks_;
+    ListenerStats stats_;
+    atomic<bool> failed_{false};
+    int udp_ = -1;
+    int tcp_ = -1;
+};
+
+#endif // LISTENER_H
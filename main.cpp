@@ -1,96 +1,138 @@
 #include <clickhouse/client.h>
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
-#include <sstream>
-#include <iomanip>
 #include <stdexcept>
 #include <unordered_map>
+#include "catalog.h"
 #include "schemas.h"
+#include "types.h"
+#include "insert.h"
+#include "batcher.h"
+#include "ingest.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "generate.h"
+#include "listener.h"
+#include "metrics.h"
+#include "router.h"
+#include "trace.h"
 
 using namespace clickhouse;
 using namespace std;
 
-using Col = pair<string, string>;
-using TblCol = vector<Col>;
 using Tbl = pair<string, TblCol>;
 using Db = vector<Tbl>;
 
-string join(const vector<string>& elements, const string& delimiter) {
-    ostringstream os;
-    for (auto it = elements.begin(); it != elements.end(); ++it) {
-        if (it != elements.begin()) {
-            os << delimiter;
-        }
-        os << *it;
-    }
-    return os.str();
-}
+int main(int argc, char* argv[]) {
+    ClientOptions options;
+    options.SetHost("localhost");
 
-vector<string> getTables(Client& client) {
-    vector<string> tables;
-    client.Select("SHOW TABLES", [&](const Block& block) {
-        for (size_t i = 0; i < block.GetRowCount(); ++i) {
-            string table(block[0]->As<ColumnString>()->At(i));
-            tables.push_back(table);
+    // listen — долгоживущий приём syslog с маршрутизацией по таблицам
+    bool listenMode = argc > 1 && string(argv[1]) == "listen";
+    // generate — синтетическая нагрузка по эталонным схемам
+    bool generateMode = argc > 1 && string(argv[1]) == "generate";
+    bool ingestMode = listenMode || generateMode || (argc > 1 && string(argv[1]) == "ingest");
+    IngestOptions ingestOptions;
+    GenerateOptions generateOptions;
+    if (ingestMode) {
+        try {
+            vector<string> args(argv + 2, argv + argc);
+            if (generateMode) {
+                generateOptions = parseGenerateArgs(args, ingestOptions);
+            } else if (listenMode) {
+                args.insert(args.begin(), "--route");
+            }
+            if (!generateMode) {
+                ingestOptions = parseIngestArgs(args);
+            }
+            if (listenMode && !ingestOptions.udpPort && !ingestOptions.tcpPort) {
+                throw invalid_argument("Для режима listen нужен --udp PORT и/или --tcp PORT");
+            }
+            if (listenMode && ingestOptions.format == IngestFormat::Csv) {
+                // Сообщения syslog по умолчанию несут JSON
+                bool explicitFormat = find(args.begin(), args.end(), "--format") != args.end();
+                if (!explicitFormat) {
+                    ingestOptions.format = IngestFormat::JsonLines;
+                }
+            }
+        } catch (const exception& e) {
+            cerr << "Ошибка: " << e.what() << endl;
+            return 1;
         }
-    });
-    return tables;
-}
-
-TblCol getTableSchema(Client& client, const string& table_name) {
-    TblCol columns;
-    string query = "SELECT name, type FROM system.columns WHERE table = '" + table_name + "'";
-    client.Select(query, [&](const Block& block) {
-        for (size_t i = 0; i < block.GetRowCount(); ++i) {
-            string name(block[0]->As<ColumnString>()->At(i));
-            string type(block[1]->As<ColumnString>()->At(i));
-            columns.emplace_back(name, type);
+    } else if (argc > 1) {
+        // Интерактивный режим принимает только смещение часового пояса
+        try {
+            if (argc != 3 || string(argv[1]) != "--tz") {
+                throw invalid_argument("Использование: [--tz ±HH:MM] | ingest ... | listen ... | generate ...");
+            }
+            setInputTimezone(argv[2]);
+        } catch (const exception& e) {
+            cerr << "Ошибка: " << e.what() << endl;
+            return 1;
         }
-    });
-    return columns;
-}
-
-bool compareSchema(const TblCol& actual, const TblCol& expected) {
-    if (actual.size() != expected.size()) {
-        cerr << "Ошибка: Количество столбцов не совпадает." << endl;
-        return false;
     }
 
-    for (size_t i = 0; i < actual.size(); ++i) {
-        if (actual[i].first != expected[i].first || actual[i].second != expected[i].second) {
-            cerr << "Ошибка: Несоответствие в столбце '" << actual[i].first << "'. Ожидаемый тип: "
-                 << expected[i].second << ", фактический тип: " << actual[i].second << "." << endl;
-            return false;
+    unique_ptr<MetricsExporter> metrics;
+    if (ingestOptions.metricsPort || !ingestOptions.metricsFile.empty()) {
+        try {
+            metrics = make_unique<MetricsExporter>(ingestOptions.metricsPort, ingestOptions.metricsFile);
+        } catch (const exception& e) {
+            cerr << "Ошибка: " << e.what() << endl;
+            return 1;
         }
     }
 
-    return true;
-}
+    unique_ptr<TraceDumper> trace;
+    if (!ingestOptions.tracePath.empty()) {
+        trace = make_unique<TraceDumper>(ingestOptions.tracePath);
+    }
 
-int main() {
-    ClientOptions options;
-    options.SetHost("localhost");
+    // Генерация в файлы не требует сервера: столбцы берутся из эталонных схем
+    if (generateMode && !generateOptions.outDir.empty()) {
+        unordered_map<string, TblCol> referenceSchemas;
+        for (const TableDef& table : getSchemas()) {
+            TblCol& columns = referenceSchemas[string(table.name)];
+            for (const ColumnDef& column : table.columns) {
+                columns.emplace_back(string(column.name), string(typeName(column.type)));
+            }
+        }
+        try {
+            return EventGenerator(nullptr, nullptr, referenceSchemas, generateOptions, ingestOptions).run();
+        } catch (const exception& e) {
+            cerr << "Ошибка: " << e.what() << endl;
+            return 1;
+        }
+    }
 
-    Client client(options);
+    // Проверка схем и вставляющие потоки используют общие прогретые соединения;
+    // потоки генератора вставляют пакеты сами, поэтому соединений нужно не меньше, чем потоков
+    size_t connections = ingestMode ? ingestOptions.inserters : 1;
+    if (generateMode) {
+        connections = max(connections, generateOptions.threads);
+    }
+    ConnectionPool pool(options, connections);
 
-    vector<string> tables = getTables(client);
+    vector<string> tables = pool.run([](Client& client) {
+        StageTimer timer(Stage::GetTables);
+        return getTables(client);
+    });
 
     if (tables.empty()) {
         cerr << "Ошибка: В базе данных нет таблиц." << endl;
         return 1;
     }
 
-    unordered_map<string, TblCol> schemas = getSchemas();
+    auto schemaCheckStarted = chrono::steady_clock::now();
+    unordered_map<string, TblCol> actualSchemas = pool.run([](Client& client) { return getDbSchema(client); });
 
     bool allTablesMatch = true;
 
     for (const auto& table : tables) {
-        if (schemas.find(table) != schemas.end()) {
-            TblCol actualColumns = getTableSchema(client, table);
-            TblCol expectedColumns = schemas[table];
-
-            if (!compareSchema(actualColumns, expectedColumns)) {
+        if (const TableDef* expected = findSchema(table)) {
+            if (!compareSchema(actualSchemas[table], *expected)) {
                 allTablesMatch = false;
             }
         } else {
@@ -105,6 +147,68 @@ int main() {
     }
 
     cout << "Все таблицы соответствуют эталонным схемам." << endl;
+    recordLatency(Stage::SchemaCheck, chrono::steady_clock::now() - schemaCheckStarted);
+
+    if (ingestMode) {
+        if (!ingestOptions.route && find(tables.begin(), tables.end(), ingestOptions.table) == tables.end()) {
+            cerr << "Ошибка: Таблица с именем '" << ingestOptions.table << "' не найдена." << endl;
+            return 1;
+        }
+        ingestOptions.partitionKeys = pool.run([](Client& client) { return getPartitionKeys(client); });
+        const TblCol& columns = actualSchemas[ingestOptions.table];
+        auto load = [&](Spool* spool) {
+            if (generateMode) {
+                try {
+                    return EventGenerator(&pool, spool, actualSchemas, generateOptions, ingestOptions).run();
+                } catch (const exception& e) {
+                    cerr << "Ошибка: " << e.what() << endl;
+                    return 1;
+                }
+            }
+            if (ingestOptions.route) {
+                try {
+                    EventRouter router(pool, spool, actualSchemas, ingestOptions);
+                    return listenMode ? SyslogListener(router, ingestOptions).run() : router.run();
+                } catch (const exception& e) {
+                    cerr << "Ошибка: " << e.what() << endl;
+                    return 1;
+                }
+            }
+            if (ingestOptions.parsers > 1 || ingestOptions.inserters > 1) {
+                return IngestPipeline(pool, columns, ingestOptions, spool).run();
+            }
+            return runIngest(pool, columns, ingestOptions, spool);
+        };
+        if (ingestOptions.spoolDir.empty()) {
+            int status = load(nullptr);
+            printServerSummary(cout);
+            pool.printSummary(cout);
+            return status;
+        }
+
+        // Спул переживает перезапуск: сегменты прошлых запусков воспроизводятся в фоне вместе с новыми
+        Spool spool(ingestOptions.spoolDir);
+        SpoolReplayer replayer(spool, pool, [&](const string& table) -> const TblCol* {
+            auto it = actualSchemas.find(table);
+            return it == actualSchemas.end() ? nullptr : &it->second;
+        });
+        int status = load(&spool);
+        bool drained = replayer.drain();
+        printServerSummary(cout);
+        pool.printSummary(cout);
+        if (spool.quarantinedRecords() > 0) {
+            cerr << "Предупреждение: записей спула, отклонённых сервером: " << spool.quarantinedRecords()
+                 << ", они сохранены в " << spool.quarantinePath() << "." << endl;
+            status = status == 0 ? 2 : status;
+        }
+        if (!drained) {
+            cerr << "Предупреждение: сервер недоступен, записано в спул строк: " << spool.spooledRows()
+                 << ", воспроизведено: " << replayer.replayedRows() << ". Остаток хранится в "
+                 << ingestOptions.spoolDir << " до следующего запуска." << endl;
+            return status == 0 ? 3 : status;
+        }
+        return status;
+    }
 
     cout << "Доступные таблицы:" << endl;
     for (const auto& table : tables) {
@@ -120,7 +224,7 @@ int main() {
         return 1;
     }
 
-    TblCol actualColumns = getTableSchema(client, table_name);
+    TblCol actualColumns = actualSchemas[table_name];
     vector<string> values;
 
     for (const auto& col : actualColumns) {
@@ -131,50 +235,25 @@ int main() {
         value.erase(0, value.find_first_not_of(" \t\n\r\f\v"));
         value.erase(value.find_last_not_of(" \t\n\r\f\v") + 1);
 
-        try {
-            if (col.second == "DateTime64(3)") {
-                struct tm tm = {};
-                stringstream ss(value);
-                ss >> get_time(&tm, "%Y-%m-%d %H:%M:%S");
-                if (ss.fail()) {
-                    cerr << "Ошибка: Неверный формат даты и времени для значения " << value << ". Ожидаемый формат: YYYY-MM-DD HH:MM:SS" << endl;
-                    return 1;
-                }
-                value = to_string(mktime(&tm)) + ".000";
-            } else if (col.second.find("UInt32") != string::npos) {
-                uint32_t val = stoul(value);
-                value = to_string(val);
-            } else if (col.second.find("Nullable(UInt8)") != string::npos) {
-                if (!value.empty()) {
-                    uint8_t val = static_cast<uint8_t>(stoul(value));
-                    value = to_string(val);
-                } else {
-                    value = "NULL";
-                }
-            } else if (col.second.find("Nullable(String)") != string::npos) {
-                if (value.empty()) {
-                    value = "NULL";
-                } else {
-                    value = "'" + value + "'";
-                }
-            } else if (col.second.find("String") != string::npos) {
-                value = "'" + value + "'";
-            } else {
-                value = value;
-            }
-        } catch (const invalid_argument& e) {
-            cerr << "Ошибка: Столбец " << col.first << " имеет неверный тип для значения " << value << ". Ожидаемый тип: " << col.second << "." << endl;
-            return 1;
-        }
-
         values.push_back(value);
     }
 
+    TableBatcher batcher(table_name, actualColumns, BatchLimits{}, [&](const string& table, const Block& block) {
+        insertOrSpool(pool, nullptr, table, actualColumns, block);
+    });
+
+    try {
+        batcher.add(values);
+    } catch (const invalid_argument& e) {
+        cerr << "Ошибка: " << e.what() << endl;
+        return 1;
+    }
+
     try {
-        string query = "INSERT INTO " + table_name + " VALUES (" + join(values, ", ") + ")";
-        client.Execute(query);
+        batcher.flush();
         cout << "Данные успешно вставлены." << endl;
-    } catch (const ServerException& e) {
+        printServerSummary(cout);
+    } catch (const exception& e) {
         cerr << "Ошибка: " << e.what() << endl;
         return 1;
     }
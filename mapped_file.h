@@ -0,0 +1,217 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+using namespace std;
+
+// Источник входных данных: непрерывное окно непрочитанных байт, которое при необходимости дочитывается
+class InputSource {
+public:
+    virtual ~InputSource() = default;
+
+    // Непрочитанные байты; представления действительны до следующего вызова fill()
+    virtual string_view data() const = 0;
+    virtual void consume(size_t bytes) = 0;
+    // Дочитать данные в окно; false, если входной поток закончился
+    virtual bool fill() = 0;
+    // true, если представления остаются действительными до уничтожения источника (отображённый файл)
+    virtual bool stable() const {
+        return false;
+    }
+};
+
+// Файл, отображённый в память: поля читаются прямо из страничного кэша без копирования
+class MappedFile : public InputSource {
+public:
+    static constexpr size_t kReadAhead = 16 * 1024 * 1024;
+
+    explicit MappedFile(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw system_error(errno, generic_category(), "Не удалось открыть файл '" + path + "'");
+        }
+        struct stat st = {};
+        if (fstat(fd, &st) != 0) {
+            int err = errno;
+            ::close(fd);
+            throw system_error(err, generic_category(), "Не удалось получить размер файла '" + path + "'");
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                int err = errno;
+                ::close(fd);
+                throw system_error(err, generic_category(), "Не удалось отобразить файл '" + path + "'");
+            }
+            data_ = static_cast<const char*>(addr);
+            madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL);
+            advise(0);
+        }
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() override {
+        if (data_) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    // Обычный файл можно отобразить; каналы и терминалы — нет
+    static bool mappable(const string& path) {
+        struct stat st = {};
+        return path != "-" && stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+    }
+
+    string_view data() const override {
+        return string_view(data_ + offset_, size_ - offset_);
+    }
+
+    void consume(size_t bytes) override {
+        offset_ += bytes;
+        if (offset_ >= advised_) {
+            advise(offset_);
+        }
+    }
+
+    bool fill() override {
+        return false;
+    }
+
+    bool stable() const override {
+        return true;
+    }
+
+private:
+    // Упреждающее чтение следующего окна и освобождение уже прочитанных страниц
+    void advise(size_t offset) {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t begin = offset / page * page;
+        size_t length = min(kReadAhead, size_ - begin);
+        madvise(const_cast<char*>(data_) + begin, length, MADV_WILLNEED);
+        if (begin >= kReadAhead) {
+            madvise(const_cast<char*>(data_), begin - kReadAhead / page * page, MADV_DONTNEED);
+        }
+        advised_ = begin + kReadAhead / 2;
+    }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t offset_ = 0;
+    size_t advised_ = 0;
+};
+
+// Чтение из канала или stdin крупными блоками в переиспользуемый буфер
+class StreamSource : public InputSource {
+public:
+    static constexpr size_t kChunk = 1024 * 1024;
+
+    explicit StreamSource(int fd, bool owned = false) : fd_(fd), owned_(owned), buffer_(kChunk) {}
+
+    StreamSource(const StreamSource&) = delete;
+    StreamSource& operator=(const StreamSource&) = delete;
+
+    ~StreamSource() override {
+        if (owned_) {
+            ::close(fd_);
+        }
+    }
+
+    string_view data() const override {
+        return string_view(buffer_.data() + begin_, end_ - begin_);
+    }
+
+    void consume(size_t bytes) override {
+        begin_ += bytes;
+    }
+
+    bool fill() override {
+        if (eof_) {
+            return false;
+        }
+        // Перенос непрочитанного хвоста в начало буфера; буфер растёт только ради записей длиннее блока
+        memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+        if (buffer_.size() - end_ < kChunk / 2) {
+            buffer_.resize(buffer_.size() * 2);
+        }
+        while (true) {
+            ssize_t n = ::read(fd_, buffer_.data() + end_, buffer_.size() - end_);
+            if (n > 0) {
+                end_ += static_cast<size_t>(n);
+                return true;
+            }
+            if (n == 0) {
+                eof_ = true;
+                return false;
+            }
+            if (errno != EINTR) {
+                throw system_error(errno, generic_category(), "Ошибка чтения входного потока");
+            }
+        }
+    }
+
+private:
+    int fd_;
+    bool owned_;
+    vector<char> buffer_;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    bool eof_ = false;
+};
+
+// Готовый фрагмент данных в памяти, например чанк целых записей для рабочего потока
+class ChunkSource : public InputSource {
+public:
+    void reset(string_view data) {
+        data_ = data;
+    }
+
+    string_view data() const override {
+        return data_;
+    }
+
+    void consume(size_t bytes) override {
+        data_.remove_prefix(bytes);
+    }
+
+    bool fill() override {
+        return false;
+    }
+
+private:
+    string_view data_;
+};
+
+inline unique_ptr<InputSource> openInput(const string& path) {
+    if (MappedFile::mappable(path)) {
+        return make_unique<MappedFile>(path);
+    }
+    if (path == "-") {
+        return make_unique<StreamSource>(STDIN_FILENO);
+    }
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw system_error(errno, generic_category(), "Не удалось открыть файл '" + path + "'");
+    }
+    return make_unique<StreamSource>(fd, true);
+}
+
+#endif // MAPPED_FILE_H
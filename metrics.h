@@ -0,0 +1,530 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "schemas.h"
+
+using namespace std;
+
+// Стадии, время которых измеряется
+enum class Stage : uint8_t {
+    Connect,
+    GetTables,
+    SchemaCheck,
+    Convert,
+    Build,
+    Insert,
+    Spool,
+};
+
+inline constexpr size_t kStageCount = static_cast<size_t>(Stage::Spool) + 1;
+inline constexpr string_view kStageNames[kStageCount] = {"connect", "get_tables", "schema_check", "convert",
+                                                         "build",   "insert",     "spool"};
+
+// Счётчики по таблицам. Server* — то, что сообщил сервер в пакетах Progress и ProfileEvents
+enum class Counter : uint8_t {
+    Rows,
+    Bytes,
+    Batches,
+    Retries,
+    Errors,
+    RejectedRows,
+    ServerQueries,
+    ServerQueryMicroseconds,
+    ServerReadRows,
+    ServerReadBytes,
+    ServerWrittenRows,
+    ServerWrittenBytes,
+    ServerResultRows,
+    ServerResultBytes,
+    ServerCpuMicroseconds,
+};
+
+inline constexpr size_t kCounterCount = static_cast<size_t>(Counter::ServerCpuMicroseconds) + 1;
+inline constexpr string_view kCounterNames[kCounterCount] = {
+    "rows",
+    "bytes",
+    "batches",
+    "retries",
+    "errors",
+    "rejected_rows",
+    "server_queries",
+    "server_query_microseconds",
+    "server_read_rows",
+    "server_read_bytes",
+    "server_written_rows",
+    "server_written_bytes",
+    "server_result_rows",
+    "server_result_bytes",
+    "server_cpu_microseconds",
+};
+
+// Слот счётчиков таблицы: индекс эталонной схемы; затем общий слот прочих таблиц
+// и слот служебных запросов к system.* при запуске
+inline constexpr size_t kMetricsOtherTable = size(kTables);
+inline constexpr size_t kMetricsSystemQueries = size(kTables) + 1;
+inline constexpr size_t kMetricsTableSlots = size(kTables) + 2;
+
+constexpr size_t metricsTable(string_view name) {
+    int index = tableIndex(name);
+    return index >= 0 ? static_cast<size_t>(index) : kMetricsOtherTable;
+}
+
+constexpr string_view metricsTableName(size_t slot) {
+    return slot < size(kTables) ? kTables[slot].name : slot == kMetricsOtherTable ? "other" : "system";
+}
+
+// Серверная статистика одного запроса
+struct ServerStats {
+    uint64_t readRows = 0;
+    uint64_t readBytes = 0;
+    uint64_t writtenRows = 0;
+    uint64_t writtenBytes = 0;
+    // Итог результата SELECT из пакета Profile
+    uint64_t resultRows = 0;
+    uint64_t resultBytes = 0;
+    uint64_t cpuMicroseconds = 0;
+    uint64_t memoryPeak = 0;
+    // От отправки запроса до получения ответа, как видит клиент
+    chrono::nanoseconds elapsed{0};
+};
+
+// Включается при заданных --metrics-port или --metrics-file; выключенные метрики стоят одну проверку флага
+inline atomic<bool> metricsEnabled{false};
+
+// Логарифмически-линейная шкала в духе HDR Histogram: 16 корзин на каждую степень двойки
+// (погрешность не больше 1/16), значения в наносекундах до 2^40 (около 18 минут)
+struct LatencyScale {
+    static constexpr unsigned kSubBits = 4;
+    static constexpr uint64_t kSubBuckets = 1 << kSubBits;
+    static constexpr unsigned kMaxExponent = 40;
+    static constexpr size_t kBuckets = (kMaxExponent - kSubBits + 1) * kSubBuckets;
+
+    static constexpr size_t bucket(uint64_t value) {
+        value = min<uint64_t>(value, (uint64_t(1) << kMaxExponent) - 1);
+        if (value < kSubBuckets) {
+            return static_cast<size_t>(value);
+        }
+        unsigned exponent = static_cast<unsigned>(bit_width(value)) - 1;
+        uint64_t sub = (value >> (exponent - kSubBits)) & (kSubBuckets - 1);
+        return (exponent - kSubBits + 1) * kSubBuckets + sub;
+    }
+
+    // Верхняя граница корзины (не включая)
+    static constexpr uint64_t upperBound(size_t index) {
+        if (index < kSubBuckets) {
+            return index + 1;
+        }
+        unsigned exponent = static_cast<unsigned>(index / kSubBuckets) + kSubBits - 1;
+        uint64_t sub = index % kSubBuckets;
+        return (kSubBuckets + sub + 1) << (exponent - kSubBits);
+    }
+};
+
+// Метрики одного потока. Пишет только поток-владелец, поэтому вместо атомарного сложения
+// достаточно пары relaxed load/store; сборщик читает те же атомики без блокировок
+struct MetricsShard {
+    array<array<atomic<uint64_t>, LatencyScale::kBuckets>, kStageCount> latency{};
+    array<atomic<uint64_t>, kStageCount> latencySum{};
+    array<array<atomic<uint64_t>, kCounterCount>, kMetricsTableSlots> counters{};
+    array<atomic<uint64_t>, kMetricsTableSlots> serverMemoryPeak{};
+
+    static void bump(atomic<uint64_t>& cell, uint64_t value) {
+        cell.store(cell.load(memory_order_relaxed) + value, memory_order_relaxed);
+    }
+};
+
+// Сводка по всем потокам
+struct MetricsSnapshot {
+    array<array<uint64_t, LatencyScale::kBuckets>, kStageCount> latency{};
+    array<uint64_t, kStageCount> latencySum{};
+    array<array<uint64_t, kCounterCount>, kMetricsTableSlots> counters{};
+    array<uint64_t, kMetricsTableSlots> serverMemoryPeak{};
+
+    uint64_t counter(size_t table, Counter counter) const {
+        return counters[table][static_cast<size_t>(counter)];
+    }
+
+    uint64_t count(Stage stage) const {
+        uint64_t total = 0;
+        for (uint64_t n : latency[static_cast<size_t>(stage)]) {
+            total += n;
+        }
+        return total;
+    }
+
+    // Квантиль задержки стадии в наносекундах (верхняя граница корзины)
+    uint64_t quantile(Stage stage, double q) const {
+        const auto& buckets = latency[static_cast<size_t>(stage)];
+        uint64_t total = count(stage);
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return LatencyScale::upperBound(i);
+            }
+        }
+        return LatencyScale::upperBound(buckets.size() - 1);
+    }
+};
+
+// Реестр потоковых метрик. Поток получает свою часть при первом измерении; после завершения потока
+// часть со всеми накопленными значениями переходит следующему новому потоку, поэтому число частей
+// не превышает наибольшего числа одновременно живших потоков
+class Metrics {
+public:
+    static Metrics& instance() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    MetricsShard& local() {
+        thread_local Handle handle;
+        if (!handle.shard) {
+            handle.shard = acquire();
+        }
+        return *handle.shard;
+    }
+
+    MetricsSnapshot snapshot() {
+        MetricsSnapshot result;
+        lock_guard<mutex> lock(mutex_);
+        for (const auto& shard : shards_) {
+            for (size_t s = 0; s < kStageCount; ++s) {
+                for (size_t b = 0; b < LatencyScale::kBuckets; ++b) {
+                    result.latency[s][b] += shard->latency[s][b].load(memory_order_relaxed);
+                }
+                result.latencySum[s] += shard->latencySum[s].load(memory_order_relaxed);
+            }
+            for (size_t t = 0; t < kMetricsTableSlots; ++t) {
+                for (size_t c = 0; c < kCounterCount; ++c) {
+                    result.counters[t][c] += shard->counters[t][c].load(memory_order_relaxed);
+                }
+                result.serverMemoryPeak[t] =
+                    max(result.serverMemoryPeak[t], shard->serverMemoryPeak[t].load(memory_order_relaxed));
+            }
+        }
+        return result;
+    }
+
+private:
+    struct Handle {
+        MetricsShard* shard = nullptr;
+
+        ~Handle() {
+            if (shard) {
+                Metrics::instance().release(shard);
+            }
+        }
+    };
+
+    MetricsShard* acquire() {
+        lock_guard<mutex> lock(mutex_);
+        if (!free_.empty()) {
+            MetricsShard* shard = free_.back();
+            free_.pop_back();
+            return shard;
+        }
+        shards_.push_back(make_unique<MetricsShard>());
+        return shards_.back().get();
+    }
+
+    void release(MetricsShard* shard) {
+        lock_guard<mutex> lock(mutex_);
+        free_.push_back(shard);
+    }
+
+    mutex mutex_;
+    vector<unique_ptr<MetricsShard>> shards_;
+    vector<MetricsShard*> free_;
+};
+
+inline void recordLatency(Stage stage, chrono::nanoseconds elapsed) {
+    if (!metricsEnabled.load(memory_order_relaxed)) {
+        return;
+    }
+    MetricsShard& shard = Metrics::instance().local();
+    uint64_t value = static_cast<uint64_t>(max<int64_t>(elapsed.count(), 0));
+    size_t s = static_cast<size_t>(stage);
+    MetricsShard::bump(shard.latency[s][LatencyScale::bucket(value)], 1);
+    MetricsShard::bump(shard.latencySum[s], value);
+}
+
+inline void addCounter(size_t table, Counter counter, uint64_t value = 1) {
+    if (!metricsEnabled.load(memory_order_relaxed)) {
+        return;
+    }
+    MetricsShard::bump(Metrics::instance().local().counters[table][static_cast<size_t>(counter)], value);
+}
+
+// Серверная статистика пишется всегда, а не только при включённых метриках: запись делается раз
+// на запрос, а не на строку, и нужна итоговой сводке запуска
+inline void recordServerStats(size_t table, const ServerStats& stats) {
+    MetricsShard& shard = Metrics::instance().local();
+    auto& counters = shard.counters[table];
+    auto bump = [&](Counter counter, uint64_t value) {
+        MetricsShard::bump(counters[static_cast<size_t>(counter)], value);
+    };
+    bump(Counter::ServerQueries, 1);
+    bump(Counter::ServerQueryMicroseconds,
+         static_cast<uint64_t>(chrono::duration_cast<chrono::microseconds>(stats.elapsed).count()));
+    bump(Counter::ServerReadRows, stats.readRows);
+    bump(Counter::ServerReadBytes, stats.readBytes);
+    bump(Counter::ServerWrittenRows, stats.writtenRows);
+    bump(Counter::ServerWrittenBytes, stats.writtenBytes);
+    bump(Counter::ServerResultRows, stats.resultRows);
+    bump(Counter::ServerResultBytes, stats.resultBytes);
+    bump(Counter::ServerCpuMicroseconds, stats.cpuMicroseconds);
+    atomic<uint64_t>& peak = shard.serverMemoryPeak[table];
+    if (stats.memoryPeak > peak.load(memory_order_relaxed)) {
+        peak.store(stats.memoryPeak, memory_order_relaxed);
+    }
+}
+
+// Замер стадии от создания до разрушения объекта
+class StageTimer {
+public:
+    explicit StageTimer(Stage stage) : stage_(stage), enabled_(metricsEnabled.load(memory_order_relaxed)) {
+        if (enabled_) {
+            started_ = chrono::steady_clock::now();
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    ~StageTimer() {
+        if (enabled_) {
+            recordLatency(stage_, chrono::steady_clock::now() - started_);
+        }
+    }
+
+private:
+    Stage stage_;
+    bool enabled_;
+    chrono::steady_clock::time_point started_;
+};
+
+// Метрики в текстовом формате Prometheus: задержки стадий как summary с квантилями, счётчики по таблицам
+inline string formatPrometheus(const MetricsSnapshot& snapshot) {
+    string out;
+    char line[256];
+    out += "# HELP ingest_stage_latency_seconds Latency of ingest stages.\n";
+    out += "# TYPE ingest_stage_latency_seconds summary\n";
+    for (size_t s = 0; s < kStageCount; ++s) {
+        Stage stage = static_cast<Stage>(s);
+        uint64_t count = snapshot.count(stage);
+        if (count == 0) {
+            continue;
+        }
+        string_view name = kStageNames[s];
+        for (double q : {0.5, 0.9, 0.99, 0.999}) {
+            snprintf(line, sizeof(line), "ingest_stage_latency_seconds{stage=\"%.*s\",quantile=\"%g\"} %.9f\n",
+                     static_cast<int>(name.size()), name.data(), q, snapshot.quantile(stage, q) / 1e9);
+            out += line;
+        }
+        snprintf(line, sizeof(line), "ingest_stage_latency_seconds_sum{stage=\"%.*s\"} %.9f\n",
+                 static_cast<int>(name.size()), name.data(), snapshot.latencySum[s] / 1e9);
+        out += line;
+        snprintf(line, sizeof(line), "ingest_stage_latency_seconds_count{stage=\"%.*s\"} %llu\n",
+                 static_cast<int>(name.size()), name.data(), static_cast<unsigned long long>(count));
+        out += line;
+    }
+    for (size_t c = 0; c < kCounterCount; ++c) {
+        string_view counter = kCounterNames[c];
+        snprintf(line, sizeof(line), "# TYPE ingest_%.*s_total counter\n", static_cast<int>(counter.size()),
+                 counter.data());
+        out += line;
+        for (size_t t = 0; t < kMetricsTableSlots; ++t) {
+            uint64_t value = snapshot.counters[t][c];
+            if (value == 0) {
+                continue;
+            }
+            string_view table = metricsTableName(t);
+            snprintf(line, sizeof(line), "ingest_%.*s_total{table=\"%.*s\"} %llu\n", static_cast<int>(counter.size()),
+                     counter.data(), static_cast<int>(table.size()), table.data(),
+                     static_cast<unsigned long long>(value));
+            out += line;
+        }
+    }
+    out += "# TYPE ingest_server_memory_peak_bytes gauge\n";
+    for (size_t t = 0; t < kMetricsTableSlots; ++t) {
+        if (snapshot.serverMemoryPeak[t] == 0) {
+            continue;
+        }
+        string_view table = metricsTableName(t);
+        snprintf(line, sizeof(line), "ingest_server_memory_peak_bytes{table=\"%.*s\"} %llu\n",
+                 static_cast<int>(table.size()), table.data(),
+                 static_cast<unsigned long long>(snapshot.serverMemoryPeak[t]));
+        out += line;
+    }
+    return out;
+}
+
+// Итоговая сводка запуска: для каждой таблицы — что сервер сообщил о записанных данных, пике памяти
+// и процессорном времени, рядом с временем запросов и полным временем вставки на клиенте
+// (с ожиданием соединения и повторами; известно при включённых метриках)
+inline void printServerSummary(ostream& out) {
+    MetricsSnapshot snapshot = Metrics::instance().snapshot();
+    bool header = false;
+    for (size_t t = 0; t < kMetricsTableSlots; ++t) {
+        uint64_t queries = snapshot.counter(t, Counter::ServerQueries);
+        if (queries == 0) {
+            continue;
+        }
+        if (!header) {
+            out << "Статистика сервера:" << endl;
+            header = true;
+        }
+        out << "- " << metricsTableName(t) << ": запросов " << queries;
+        if (uint64_t rows = snapshot.counter(t, Counter::ServerWrittenRows)) {
+            out << ", записано строк " << rows << " (" << snapshot.counter(t, Counter::ServerWrittenBytes) / 1024
+                << " КиБ)";
+        }
+        if (uint64_t rows = snapshot.counter(t, Counter::ServerReadRows)) {
+            out << ", прочитано строк " << rows << " (" << snapshot.counter(t, Counter::ServerReadBytes) / 1024
+                << " КиБ)";
+        }
+        out << ", время запросов " << snapshot.counter(t, Counter::ServerQueryMicroseconds) / 1e6 << " с"
+            << ", ЦП сервера " << snapshot.counter(t, Counter::ServerCpuMicroseconds) / 1e6 << " с";
+        if (snapshot.serverMemoryPeak[t]) {
+            out << ", пик памяти " << snapshot.serverMemoryPeak[t] / (1024 * 1024) << " МиБ";
+        }
+        out << endl;
+    }
+    if (header && snapshot.count(Stage::Insert) > 0) {
+        out << "Вставка на клиенте, всего: " << snapshot.latencySum[static_cast<size_t>(Stage::Insert)] / 1e9
+            << " с, p99 пакета: " << snapshot.quantile(Stage::Insert, 0.99) / 1e6 << " мс" << endl;
+    }
+}
+
+// Публикация метрик: HTTP-эндпоинт Prometheus на локальном порту и/или файл для textfile-коллектора
+// node_exporter, который перезаписывается целиком через переименование временного файла
+class MetricsExporter {
+public:
+    MetricsExporter(uint16_t port, string path, chrono::seconds interval = chrono::seconds(10))
+        : path_(move(path)), interval_(interval) {
+        metricsEnabled = true;
+        if (port) {
+            listener_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            int on = 1;
+            ::setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (listener_ < 0 || ::bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+                ::listen(listener_, 16) != 0) {
+                if (listener_ >= 0) {
+                    ::close(listener_);
+                }
+                throw runtime_error("Не удалось открыть порт метрик " + to_string(port));
+            }
+        }
+        worker_ = thread([this] { run(); });
+    }
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    ~MetricsExporter() {
+        stopping_ = true;
+        worker_.join();
+        if (listener_ >= 0) {
+            ::close(listener_);
+        }
+        writeFile();
+    }
+
+private:
+    void run() {
+        auto nextWrite = chrono::steady_clock::now() + interval_;
+        while (!stopping_) {
+            if (listener_ >= 0) {
+                pollfd pfd{listener_, POLLIN, 0};
+                if (::poll(&pfd, 1, 200) > 0) {
+                    serve();
+                }
+            } else {
+                this_thread::sleep_for(chrono::milliseconds(200));
+            }
+            if (chrono::steady_clock::now() >= nextWrite) {
+                writeFile();
+                nextWrite += interval_;
+            }
+        }
+    }
+
+    // Один запрос на соединение: содержимое запроса не важно, ответ — всегда текущие метрики
+    void serve() {
+        int fd = ::accept4(listener_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        timeval timeout{1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        char request[4096];
+        (void)::recv(fd, request, sizeof(request), 0);
+        string body = formatPrometheus(Metrics::instance().snapshot());
+        string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                          to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        for (size_t sent = 0; sent < response.size();) {
+            ssize_t n = ::send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        ::close(fd);
+    }
+
+    void writeFile() {
+        if (path_.empty()) {
+            return;
+        }
+        string temporary = path_ + ".tmp";
+        {
+            ofstream file(temporary, ios::binary | ios::trunc);
+            file << formatPrometheus(Metrics::instance().snapshot());
+            if (!file) {
+                cerr << "Предупреждение: не удалось записать метрики в " << temporary << endl;
+                return;
+            }
+        }
+        if (::rename(temporary.c_str(), path_.c_str()) != 0) {
+            cerr << "Предупреждение: не удалось заменить файл метрик " << path_ << endl;
+        }
+    }
+
+    string path_;
+    chrono::seconds interval_;
+    int listener_ = -1;
+    atomic<bool> stopping_{false};
+    thread worker_;
+};
+
+#endif // METRICS_H
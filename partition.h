@@ -0,0 +1,114 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include "datetime.h"
+#include "schemas.h"
+#include "types.h"
+
+using namespace std;
+
+// Ключ партиционирования таблицы, вычисляемый на клиенте. Поддерживаются выражения вида f(столбец)
+// над DateTime64 — toYYYYMM, toYYYYMMDD, toDate, toMonday, toStartOfHour и т. п. Значение считается
+// в UTC: при другом часовом поясе сервера граница корзины может сдвинуться на несколько часов,
+// что влияет только на число частей, но не на корректность вставки.
+struct PartitionKey {
+    enum class Granularity : uint8_t { None, Year, Month, Week, Day, Hour };
+
+    Granularity granularity = Granularity::None;
+    int column = -1;
+    unsigned precision = 0;
+
+    bool enabled() const {
+        return granularity != Granularity::None;
+    }
+
+    // Номер корзины для значения столбца; 0 для неразбираемого значения (строка всё равно будет отклонена)
+    int64_t bucket(string_view value) const {
+        int64_t ticks = 0;
+        if (!parseDateTime64(value, precision, ticks)) {
+            return 0;
+        }
+        int64_t seconds = ticks / kPow10[precision] - (ticks % kPow10[precision] < 0);
+        int64_t days = seconds / 86400 - (seconds % 86400 < 0);
+        int64_t year = 0;
+        unsigned month = 0;
+        unsigned day = 0;
+        switch (granularity) {
+            case Granularity::None:
+                return 0;
+            case Granularity::Year:
+                civilFromDays(days, year, month, day);
+                return year;
+            case Granularity::Month:
+                civilFromDays(days, year, month, day);
+                return year * 12 + month;
+            case Granularity::Week:
+                // 1970-01-01 — четверг; неделя начинается с понедельника
+                return (days + 3 - ((days + 3) % 7 + 7) % 7) / 7;
+            case Granularity::Day:
+                return days;
+            case Granularity::Hour:
+                return seconds / 3600 - (seconds % 3600 < 0);
+        }
+        return 0;
+    }
+};
+
+// Разбор partition_key из system.tables. Неподдерживаемое выражение даёт ключ без разбиения.
+inline PartitionKey parsePartitionKey(string_view expression, const TblCol& columns) {
+    auto trim = [](string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '(')) {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && (s.back() == ' ' || s.back() == ')')) {
+            s.remove_suffix(1);
+        }
+        return s;
+    };
+
+    PartitionKey key;
+    string_view text = trim(expression);
+    if (text.empty() || expression == "tuple()") {
+        return key;
+    }
+    size_t open = text.find('(');
+    if (open == string_view::npos) {
+        cerr << "Предупреждение: ключ партиционирования '" << expression
+             << "' не поддерживается, пакеты не разбиваются по партициям." << endl;
+        return key;
+    }
+    string_view function = trim(text.substr(0, open));
+    string_view argument = trim(text.substr(open + 1));
+
+    using G = PartitionKey::Granularity;
+    static constexpr pair<string_view, G> kFunctions[] = {
+        {"toYear", G::Year},          {"toStartOfYear", G::Year}, {"toYYYYMM", G::Month},
+        {"toStartOfMonth", G::Month}, {"toMonday", G::Week},      {"toYYYYMMDD", G::Day},
+        {"toDate", G::Day},           {"toDate32", G::Day},       {"toStartOfDay", G::Day},
+        {"toStartOfHour", G::Hour},
+    };
+    G granularity = G::None;
+    for (const auto& [name, value] : kFunctions) {
+        if (function == name) {
+            granularity = value;
+        }
+    }
+    for (size_t i = 0; i < columns.size() && granularity != G::None; ++i) {
+        const TypeDesc& desc = typeDesc(internType(columns[i].second));
+        if (columns[i].first == argument && desc.base == BaseType::DateTime64) {
+            key.granularity = granularity;
+            key.column = static_cast<int>(i);
+            key.precision = desc.precision;
+            return key;
+        }
+    }
+    cerr << "Предупреждение: ключ партиционирования '" << expression
+         << "' не поддерживается, пакеты не разбиваются по партициям." << endl;
+    return key;
+}
+
+#endif // PARTITION_H
@@ -0,0 +1,279 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "ingest.h"
+#include "ring.h"
+
+using namespace std;
+
+// Фрагмент входа из целых записей: представление в отображённый файл или собственная копия данных из канала
+struct Chunk {
+    string owned;
+    string_view mapped;
+
+    string_view view() const {
+        return owned.empty() ? mapped : string_view(owned);
+    }
+};
+
+// Счётчики и глубины очередей конвейера
+struct PipelineStats {
+    atomic<size_t> chunks{0};
+    atomic<size_t> parsedRows{0};
+    atomic<size_t> errors{0};
+    atomic<size_t> blocks{0};
+    atomic<size_t> insertedRows{0};
+};
+
+// Граница чанка: конец первой записи, заканчивающейся не раньше target; npos, если в окне такой нет
+inline size_t findChunkEnd(string_view data, size_t target, bool quoteAware) {
+    if (data.size() <= target) {
+        return string_view::npos;
+    }
+    if (!quoteAware) {
+        const char* nl = static_cast<const char*>(memchr(data.data() + target, '\n', data.size() - target));
+        return nl ? static_cast<size_t>(nl - data.data()) + 1 : string_view::npos;
+    }
+    bool quoted = false;
+    for (size_t i = 0; i < data.size(); ++i) {
+        if (data[i] == '"') {
+            quoted = !quoted;
+        } else if (data[i] == '\n' && !quoted && i >= target) {
+            return i + 1;
+        }
+    }
+    return string_view::npos;
+}
+
+// Многопоточная загрузка: чтение -> N потоков разбора и преобразования -> M потоков вставки,
+// каждый со своим соединением из пула. Стадии связаны ограниченными кольцами с обратным давлением.
+class IngestPipeline {
+public:
+    static constexpr size_t kChunkBytes = 1024 * 1024;
+
+    IngestPipeline(ConnectionPool& pool, const TblCol& columns, const IngestOptions& options, Spool* spool = nullptr)
+        : pool_(pool), spool_(spool), columns_(columns), options_(options),
+          chunks_(options.parsers * 4), blocks_(options.inserters * 2) {}
+
+    int run() {
+        auto started = chrono::steady_clock::now();
+        unique_ptr<InputSource> source;
+        try {
+            source = openInput(options_.path);
+            if (options_.header && options_.format != IngestFormat::JsonLines) {
+                mapping_ = DelimitedReader(*source, columns_, options_.format, true).mapping();
+            }
+        } catch (const exception& e) {
+            cerr << "Ошибка: " << e.what() << endl;
+            return 1;
+        }
+
+        vector<thread> inserters;
+        for (size_t i = 0; i < options_.inserters; ++i) {
+            inserters.emplace_back([this] { insertLoop(); });
+        }
+        vector<thread> parsers;
+        for (size_t i = 0; i < options_.parsers; ++i) {
+            parsers.emplace_back([this] { parseLoop(); });
+        }
+        thread monitor([this] { monitorLoop(); });
+
+        try {
+            readLoop(*source);
+        } catch (const exception& e) {
+            fail(e.what());
+        }
+        chunks_.close();
+        for (auto& t : parsers) {
+            t.join();
+        }
+        blocks_.close();
+        for (auto& t : inserters) {
+            t.join();
+        }
+        {
+            lock_guard<mutex> lock(monitorMutex_);
+            done_ = true;
+        }
+        monitorCv_.notify_all();
+        monitor.join();
+
+        if (failed_.load()) {
+            cerr << "Ошибка: " << failure_ << endl;
+            return 1;
+        }
+        size_t rows = stats_.insertedRows.load();
+        size_t errors = stats_.errors.load();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        cout << "Загружено строк: " << rows << ", пропущено с ошибками: " << errors << ", пакетов: "
+             << stats_.blocks.load() << ", время: " << seconds << " с, скорость: "
+             << static_cast<size_t>(seconds > 0 ? rows / seconds : 0) << " строк/с." << endl;
+        return errors == 0 ? 0 : 2;
+    }
+
+private:
+    // Стадия чтения: нарезка входа на чанки из целых записей
+    void readLoop(InputSource& source) {
+        bool quoteAware = options_.format == IngestFormat::Csv;
+        while (!failed_.load(memory_order_relaxed)) {
+            string_view data = source.data();
+            size_t end = findChunkEnd(data, kChunkBytes, quoteAware);
+            if (end == string_view::npos) {
+                if (source.fill()) {
+                    continue;
+                }
+                if (data.empty()) {
+                    return;
+                }
+                end = data.size();
+            }
+
+            Chunk chunk;
+            if (source.stable()) {
+                chunk.mapped = data.substr(0, end);
+            } else {
+                chunk.owned.assign(data.data(), end);
+            }
+            source.consume(end);
+            stats_.chunks.fetch_add(1, memory_order_relaxed);
+            if (!chunks_.push(move(chunk))) {
+                return;
+            }
+        }
+    }
+
+    // Стадия разбора: записи чанков преобразуются в типизированные столбцы и собираются в блоки
+    void parseLoop() {
+        ChunkSource source;
+        unique_ptr<RecordReader> reader;
+        if (options_.format == IngestFormat::JsonLines) {
+            reader = make_unique<JsonLinesReader>(source, columns_);
+        } else {
+            reader = make_unique<DelimitedReader>(source, columns_, options_.format, mapping_);
+        }
+
+        try {
+            PartitionedBuilder builder(columns_, options_.limits, partitionKeyFor(options_, options_.table, columns_));
+            vector<Batch> ready;
+            vector<string_view> values;
+            Chunk chunk;
+            // Корзины, ждущие дольше maxAge, сбрасываются и между чанками, и при простое входа
+            while (true) {
+                auto deadline = builder.deadline().value_or(chrono::steady_clock::time_point::max());
+                PopStatus status = chunks_.popUntil(chunk, deadline);
+                if (status == PopStatus::Closed) {
+                    break;
+                }
+                if (status == PopStatus::Timeout) {
+                    builder.takeExpired(chrono::steady_clock::now(), ready);
+                    if (!pushReady(ready)) {
+                        return;
+                    }
+                    continue;
+                }
+                source.reset(chunk.view());
+                while (true) {
+                    try {
+                        if (!reader->next(values)) {
+                            break;
+                        }
+                        builder.appendRow(values, ready);
+                    } catch (const invalid_argument& e) {
+                        addCounter(metricsTable(options_.table), Counter::RejectedRows);
+                        if (stats_.errors.fetch_add(1, memory_order_relaxed) < 10) {
+                            lock_guard<mutex> lock(logMutex_);
+                            cerr << "Ошибка в записи: " << e.what() << endl;
+                        }
+                        continue;
+                    }
+                    stats_.parsedRows.fetch_add(1, memory_order_relaxed);
+                    if (!pushReady(ready)) {
+                        return;
+                    }
+                }
+                builder.takeExpired(chrono::steady_clock::now(), ready);
+                if (!pushReady(ready)) {
+                    return;
+                }
+            }
+            builder.takeAll(ready);
+            pushReady(ready);
+        } catch (const exception& e) {
+            fail(e.what());
+        }
+    }
+
+    bool pushReady(vector<Batch>& ready) {
+        for (Batch& batch : ready) {
+            if (!blocks_.push(move(batch))) {
+                return false;
+            }
+        }
+        ready.clear();
+        return true;
+    }
+
+    // Стадия вставки: пул рассчитан на число потоков вставки, поэтому каждый поток получает своё соединение
+    void insertLoop() {
+        try {
+            Batch batch;
+            while (blocks_.pop(batch)) {
+                insertOrSpool(pool_, spool_, options_.table, columns_, batch.block);
+                stats_.blocks.fetch_add(1, memory_order_relaxed);
+                stats_.insertedRows.fetch_add(batch.rows(), memory_order_relaxed);
+            }
+        } catch (const exception& e) {
+            fail(e.what());
+        }
+    }
+
+    // Раз в секунду выводит глубины очередей между стадиями
+    void monitorLoop() {
+        unique_lock<mutex> lock(monitorMutex_);
+        while (!monitorCv_.wait_for(lock, chrono::seconds(1), [this] { return done_; })) {
+            lock_guard<mutex> logLock(logMutex_);
+            cerr << "Конвейер: чанков в очереди " << chunks_.size() << "/" << chunks_.capacity() << ", блоков в очереди "
+                 << blocks_.size() << "/" << blocks_.capacity() << ", разобрано строк " << stats_.parsedRows.load()
+                 << ", вставлено строк " << stats_.insertedRows.load() << endl;
+        }
+    }
+
+    void fail(const string& message) {
+        bool expected = false;
+        if (failed_.compare_exchange_strong(expected, true)) {
+            failure_ = message;
+        }
+        chunks_.close();
+        blocks_.close();
+    }
+
+    ConnectionPool& pool_;
+    Spool* spool_;
+    const TblCol& columns_;
+    IngestOptions options_;
+    vector<int> mapping_;
+
+    BoundedRing<Chunk> chunks_;
+    BoundedRing<Batch> blocks_;
+    PipelineStats stats_;
+
+    atomic<bool> failed_{false};
+    string failure_;
+    mutex logMutex_;
+    mutex monitorMutex_;
+    condition_variable monitorCv_;
+    bool done_ = false;
+};
+
+#endif // PIPELINE_H
@@ -0,0 +1,269 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <clickhouse/client.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "metrics.h"
+#include "trace.h"
+
+using namespace clickhouse;
+using namespace std;
+
+// Статистика одного соединения пула
+struct ConnectionStats {
+    size_t connects = 0;
+    size_t leases = 0;
+    size_t failures = 0;
+    size_t pingFailures = 0;
+    chrono::nanoseconds busy{0};
+};
+
+// Политика повторов: экспоненциальная задержка со случайным разбросом и верхней границей.
+// Повторы безопасны, потому что каждая вставка несёт токен дедупликации.
+struct RetryPolicy {
+    size_t attempts = 6;
+    chrono::milliseconds initialDelay{100};
+    chrono::milliseconds maxDelay{5000};
+
+    // Задержка перед повтором attempt (с 1): случайная в [d/2, d], где d = min(maxDelay, initialDelay * 2^(attempt-1))
+    chrono::milliseconds delay(size_t attempt) const {
+        thread_local mt19937 random{random_device{}()};
+        auto base = initialDelay.count() << min<size_t>(attempt - 1, 20);
+        auto capped = min<long long>(base, maxDelay.count());
+        uniform_int_distribution<long long> jitter(capped / 2, capped);
+        return chrono::milliseconds(jitter(random));
+    }
+};
+
+// Ошибки сервера, после которых вставку имеет смысл повторить
+inline bool isTransientServerError(int code) {
+    switch (code) {
+        case 159:  // TIMEOUT_EXCEEDED
+        case 202:  // TOO_MANY_SIMULTANEOUS_QUERIES
+        case 209:  // SOCKET_TIMEOUT
+        case 210:  // NETWORK_ERROR
+        case 241:  // MEMORY_LIMIT_EXCEEDED
+        case 242:  // TABLE_IS_READ_ONLY
+        case 252:  // TOO_MANY_PARTS
+        case 319:  // UNKNOWN_STATUS_OF_INSERT
+        case 999:  // KEEPER_EXCEPTION
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Ошибка, которая может пройти сама: сбой сети или сокета либо временная ошибка сервера.
+// Ошибки данных (несовпадение типа, нет столбца, неверное значение) при повторе не исчезнут
+inline bool isTransientError(const exception& e) {
+    if (auto server = dynamic_cast<const ServerException*>(&e)) {
+        return isTransientServerError(server->GetCode());
+    }
+    if (dynamic_cast<const ValidationError*>(&e)) {
+        return false;
+    }
+    return dynamic_cast<const Error*>(&e) || dynamic_cast<const system_error*>(&e);
+}
+
+// Пул соединений clickhouse::Client: ленивое подключение, проверка Ping после простоя,
+// переподключение после ошибки сервера или сокета
+class ConnectionPool {
+public:
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept : pool_(exchange(other.pool_, nullptr)), index_(other.index_),
+                                        started_(other.started_), failed_(other.failed_) {}
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        ~Lease() {
+            if (pool_) {
+                pool_->release(index_, started_, failed_);
+            }
+        }
+
+        Client& operator*() const {
+            return *pool_->slots_[index_].client;
+        }
+
+        Client* operator->() const {
+            return pool_->slots_[index_].client.get();
+        }
+
+        // Соединение после ошибки не возвращается в пул: следующий захват подключится заново
+        void fail() {
+            failed_ = true;
+        }
+
+    private:
+        friend class ConnectionPool;
+
+        Lease(ConnectionPool* pool, size_t index)
+            : pool_(pool), index_(index), started_(chrono::steady_clock::now()) {}
+
+        ConnectionPool* pool_;
+        size_t index_;
+        chrono::steady_clock::time_point started_;
+        bool failed_ = false;
+    };
+
+    ConnectionPool(const ClientOptions& options, size_t size, RetryPolicy retry = {},
+                   chrono::seconds pingAfterIdle = chrono::seconds(30))
+        : options_(options), retry_(retry), pingAfterIdle_(pingAfterIdle), slots_(max<size_t>(size, 1)) {}
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    // Захват свободного соединения; ждёт, если все заняты
+    Lease acquire() {
+        size_t index = 0;
+        {
+            unique_lock<mutex> lock(mutex_);
+            cv_.wait(lock, [&] { return findFree(index); });
+            slots_[index].busy = true;
+        }
+        try {
+            prepare(slots_[index]);
+        } catch (...) {
+            lock_guard<mutex> lock(mutex_);
+            slots_[index].busy = false;
+            slots_[index].stats.failures++;
+            cv_.notify_one();
+            throw;
+        }
+        return Lease(this, index);
+    }
+
+    // Выполнение fn(Client&) на соединении из пула. Сетевые и временные ошибки сервера повторяются
+    // по политике retry_ на новом соединении; прочие ошибки сервера пробрасываются сразу.
+    template <typename Fn>
+    auto run(Fn&& fn) {
+        for (size_t attempt = 1;; ++attempt) {
+            try {
+                Lease lease = acquire();
+                try {
+                    return fn(*lease);
+                } catch (...) {
+                    // После ошибки состояние соединения не гарантировано
+                    lease.fail();
+                    throw;
+                }
+            } catch (const exception& e) {
+                if (!isTransientError(e) || attempt >= retry_.attempts) {
+                    throw;
+                }
+            }
+            this_thread::sleep_for(retry_.delay(attempt));
+        }
+    }
+
+    size_t size() const {
+        return slots_.size();
+    }
+
+    vector<ConnectionStats> stats() const {
+        lock_guard<mutex> lock(mutex_);
+        vector<ConnectionStats> result;
+        for (const auto& slot : slots_) {
+            result.push_back(slot.stats);
+        }
+        return result;
+    }
+
+    // Итог по соединениям в конце запуска: неровная загрузка или частые переподключения
+    // указывают на недоступный сервер или на лишние потоки вставки
+    void printSummary(ostream& out) const {
+        vector<ConnectionStats> connections = stats();
+        out << "Соединения пула:" << endl;
+        for (size_t i = 0; i < connections.size(); ++i) {
+            const ConnectionStats& s = connections[i];
+            out << "- #" << i + 1 << ": подключений " << s.connects << ", запросов " << s.leases << ", сбоев "
+                << s.failures << ", неудачных проверок " << s.pingFailures << ", занято "
+                << chrono::duration<double>(s.busy).count() << " с" << endl;
+        }
+    }
+
+private:
+    struct Slot {
+        unique_ptr<Client> client;
+        bool busy = false;
+        chrono::steady_clock::time_point lastUsed;
+        ConnectionStats stats;
+    };
+
+    // Предпочтение уже подключённым соединениям, чтобы не открывать новые без необходимости
+    bool findFree(size_t& index) const {
+        bool found = false;
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (slots_[i].busy) {
+                continue;
+            }
+            if (slots_[i].client) {
+                index = i;
+                return true;
+            }
+            if (!found) {
+                index = i;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // Подключение по требованию и проверка соединения, которое долго простаивало
+    void prepare(Slot& slot) {
+        if (slot.client && chrono::steady_clock::now() - slot.lastUsed > pingAfterIdle_) {
+            try {
+                slot.client->Ping();
+            } catch (const exception&) {
+                slot.client.reset();
+                lock_guard<mutex> lock(mutex_);
+                slot.stats.pingFailures++;
+            }
+        }
+        if (!slot.client) {
+            StageTimer timer(Stage::Connect);
+            TraceSpan span("connect");
+            slot.client = make_unique<Client>(options_);
+            lock_guard<mutex> lock(mutex_);
+            slot.stats.connects++;
+        }
+    }
+
+    void release(size_t index, chrono::steady_clock::time_point started, bool failed) {
+        Slot& slot = slots_[index];
+        auto now = chrono::steady_clock::now();
+        if (failed) {
+            slot.client.reset();
+        }
+        lock_guard<mutex> lock(mutex_);
+        slot.busy = false;
+        slot.lastUsed = now;
+        slot.stats.leases++;
+        slot.stats.busy += now - started;
+        if (failed) {
+            slot.stats.failures++;
+        }
+        cv_.notify_one();
+    }
+
+    ClientOptions options_;
+    RetryPolicy retry_;
+    chrono::seconds pingAfterIdle_;
+    mutable mutex mutex_;
+    condition_variable cv_;
+    vector<Slot> slots_;
+};
+
+#endif // POOL_H
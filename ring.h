@@ -0,0 +1,165 @@
+#ifndef RING_H
+#define RING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+using namespace std;
+
+// Ожидание с нарастающей паузой: сначала активное, затем yield, затем короткий сон
+struct Backoff {
+    unsigned spins = 0;
+
+    void pause() {
+        if (spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        } else if (spins < 256) {
+            this_thread::yield();
+        } else {
+            this_thread::sleep_for(chrono::microseconds(50));
+        }
+        ++spins;
+    }
+};
+
+// Результат извлечения с ограничением по времени
+enum class PopStatus { Value, Timeout, Closed };
+
+// Ограниченная lock-free очередь MPMC (кольцо Вьюкова). Заполненная очередь блокирует производителя,
+// что и обеспечивает обратное давление между стадиями конвейера.
+template <typename T>
+class BoundedRing {
+public:
+    explicit BoundedRing(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        cells_ = make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; ++i) {
+            cells_[i].seq.store(i, memory_order_relaxed);
+        }
+    }
+
+    BoundedRing(const BoundedRing&) = delete;
+    BoundedRing& operator=(const BoundedRing&) = delete;
+
+    bool tryPush(T& value) {
+        size_t pos = head_.load(memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    cell.value = move(value);
+                    cell.seq.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& value) {
+        size_t pos = tail_.load(memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    value = move(cell.value);
+                    cell.seq.store(pos + mask_ + 1, memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    // Блокирующая вставка; false, если очередь закрыта
+    bool push(T value) {
+        Backoff backoff;
+        while (!closed_.load(memory_order_acquire)) {
+            if (tryPush(value)) {
+                return true;
+            }
+            backoff.pause();
+        }
+        return false;
+    }
+
+    // Блокирующее извлечение; false, если очередь закрыта и пуста
+    bool pop(T& value) {
+        Backoff backoff;
+        while (true) {
+            if (tryPop(value)) {
+                return true;
+            }
+            if (closed_.load(memory_order_acquire)) {
+                return tryPop(value);
+            }
+            backoff.pause();
+        }
+    }
+
+    // Извлечение с ожиданием не дольше deadline: стадия, у которой есть работа по таймеру, не засыпает навсегда
+    PopStatus popUntil(T& value, chrono::steady_clock::time_point deadline) {
+        Backoff backoff;
+        while (true) {
+            if (tryPop(value)) {
+                return PopStatus::Value;
+            }
+            if (closed_.load(memory_order_acquire)) {
+                return tryPop(value) ? PopStatus::Value : PopStatus::Closed;
+            }
+            if (chrono::steady_clock::now() >= deadline) {
+                return PopStatus::Timeout;
+            }
+            backoff.pause();
+        }
+    }
+
+    void close() {
+        closed_.store(true, memory_order_release);
+    }
+
+    // Приблизительная глубина очереди для статистики
+    size_t size() const {
+        size_t head = head_.load(memory_order_relaxed);
+        size_t tail = tail_.load(memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+
+    size_t capacity() const {
+        return mask_ + 1;
+    }
+
+private:
+    struct Cell {
+        atomic<size_t> seq;
+        T value;
+    };
+
+    unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    alignas(64) atomic<size_t> head_{0};
+    alignas(64) atomic<size_t> tail_{0};
+    alignas(64) atomic<bool> closed_{false};
+};
+
+#endif // RING_H
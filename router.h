@@ -0,0 +1,277 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "batcher.h"
+#include "ingest.h"
+#include "schemas.h"
+#include "spool.h"
+
+using namespace std;
+
+// Маршрутизатор смешанного потока: по значению поля-дискриминатора (msgtype по умолчанию) запись
+// направляется в накопитель своей таблицы. Накопители создаются при первой записи таблицы
+// и сбрасываются независимо — каждый по своим порогам и своим фоновым потоком. Методы route
+// можно вызывать из нескольких потоков; буфер строки у каждого потока свой.
+class EventRouter {
+public:
+    EventRouter(ConnectionPool& pool, Spool* spool, const unordered_map<string, TblCol>& schemas,
+                const IngestOptions& options)
+        : pool_(pool), spool_(spool), schemas_(schemas), options_(options) {
+        if (options_.header && options_.format != IngestFormat::JsonLines) {
+            throw invalid_argument("Заголовок не поддерживается при маршрутизации: поля записи следуют порядку "
+                                   "столбцов своей таблицы");
+        }
+        for (const auto& [value, table] : options_.routes) {
+            int index = tableIndex(table);
+            if (index < 0 || !schemas_.count(table)) {
+                throw invalid_argument("Таблица '" + table + "' из правила маршрутизации не найдена.");
+            }
+            routeByValue_[value] = index;
+        }
+        // Без правил таблица ищется по имени, а имя таблицы не пройдёт преобразование числового столбца:
+        // для msgtype по умолчанию соответствие номеров таблицам нужно задать явно
+        if (routeByValue_.empty() && !discriminatorIsText()) {
+            throw invalid_argument("Для маршрутизации по числовому полю " + options_.discriminator +
+                                   " нужны правила --map ЗНАЧЕНИЕ=ТАБЛИЦА для каждой таблицы потока "
+                                   "(или --by с полем, содержащим имя таблицы)");
+        }
+        if (options_.format != IngestFormat::JsonLines) {
+            position_ = discriminatorPosition();
+        }
+    }
+
+    EventRouter(const EventRouter&) = delete;
+    EventRouter& operator=(const EventRouter&) = delete;
+
+    int run() {
+        size_t rows = 0;
+        size_t errors = 0;
+        auto started = chrono::steady_clock::now();
+
+        try {
+            unique_ptr<InputSource> source = openInput(options_.path);
+            if (options_.format == IngestFormat::JsonLines) {
+                JsonLinesReader reader(*source, TblCol{});
+                vector<pair<string_view, string_view>> fields;
+                vector<string_view> row;
+                readAll(rows, errors, [&] { return reader.nextObject(fields); }, [&] { route(fields, row); });
+            } else {
+                DelimitedReader reader(*source, TblCol{}, options_.format, false);
+                vector<string_view> fields;
+                vector<string_view> row;
+                readAll(rows, errors, [&] { return reader.nextFields(fields); }, [&] { route(fields, row); });
+            }
+            flush();
+        } catch (const exception& e) {
+            cerr << "Ошибка: " << e.what() << endl;
+            return 1;
+        }
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        printTables();
+        cout << "Загружено строк: " << rows << ", пропущено с ошибками: " << errors << ", время: " << seconds
+             << " с, скорость: " << static_cast<size_t>(seconds > 0 ? rows / seconds : 0) << " строк/с." << endl;
+        stop();
+        return errors == 0 ? 0 : 2;
+    }
+
+    // Запись JSON: поля сопоставляются со столбцами таблицы по имени
+    void route(const vector<pair<string_view, string_view>>& fields, vector<string_view>& row) {
+        const string_view* value = nullptr;
+        for (const auto& field : fields) {
+            if (field.first == options_.discriminator) {
+                value = &field.second;
+                break;
+            }
+        }
+        if (!value) {
+            throw invalid_argument("В записи нет поля " + options_.discriminator);
+        }
+        Route& target = resolve(*value);
+        row.assign(target.columns->size(), string_view());
+        for (const auto& [key, field] : fields) {
+            auto it = target.index.find(key);
+            if (it != target.index.end()) {
+                row[it->second] = field;
+            }
+        }
+        add(target, row);
+    }
+
+    // Поля CSV/TSV следуют порядку столбцов таблицы; дискриминатор стоит на позиции первой таблицы,
+    // а затем сверяется с позицией в найденной таблице
+    void route(const vector<string_view>& fields, vector<string_view>& row) {
+        if (fields.size() <= position_) {
+            throw invalid_argument("В записи нет поля " + options_.discriminator);
+        }
+        Route& target = resolve(fields[position_]);
+        if (target.discriminator != position_) {
+            throw invalid_argument("Поле " + options_.discriminator + " в таблице стоит на другой позиции");
+        }
+        if (fields.size() != target.columns->size()) {
+            throw invalid_argument("Ожидалось полей: " + to_string(target.columns->size()) + ", получено: " +
+                                   to_string(fields.size()));
+        }
+        row.assign(fields.begin(), fields.end());
+        add(target, row);
+    }
+
+    void flush() {
+        for (auto& route : routes_) {
+            if (route.ready.load(memory_order_acquire)) {
+                route.batcher->flush();
+            }
+        }
+    }
+
+    // Остановка накопителей до разрушения пула, чтобы их фоновые потоки не пережили соединения
+    void stop() {
+        for (auto& route : routes_) {
+            route.ready.store(false, memory_order_release);
+            route.batcher.reset();
+        }
+    }
+
+    void printTables() const {
+        for (size_t i = 0; i < routes_.size(); ++i) {
+            size_t rows = routes_[i].rows.load(memory_order_relaxed);
+            if (rows > 0) {
+                cout << "  " << kTables[i].name << ": " << rows << " строк" << endl;
+            }
+        }
+    }
+
+private:
+    struct Route {
+        atomic<bool> ready{false};
+        const TblCol* columns = nullptr;
+        unique_ptr<TableBatcher> batcher;
+        unordered_map<string, size_t, StringViewHash, equal_to<>> index;
+        size_t discriminator = 0;
+        atomic<size_t> rows{0};
+    };
+
+    template <typename Next, typename Dispatch>
+    void readAll(size_t& rows, size_t& errors, Next&& next, Dispatch&& dispatch) {
+        while (true) {
+            try {
+                if (!next()) {
+                    break;
+                }
+                dispatch();
+                ++rows;
+            } catch (const invalid_argument& e) {
+                if (++errors <= 10) {
+                    cerr << "Ошибка в записи " << rows + errors << ": " << e.what() << endl;
+                }
+            }
+        }
+    }
+
+    // Таблица по значению дискриминатора: сначала явные правила --map, затем имя таблицы
+    // (с префиксом t_ или без) через совершенный хеш schemas.h
+    Route& resolve(string_view value) {
+        int index = -1;
+        auto it = routeByValue_.find(value);
+        if (it != routeByValue_.end()) {
+            index = it->second;
+        } else {
+            index = tableIndex(value);
+            if (index < 0 && value.size() < 64) {
+                char name[66] = "t_";
+                value.copy(name + 2, value.size());
+                index = tableIndex(string_view(name, value.size() + 2));
+            }
+        }
+        if (index < 0) {
+            throw invalid_argument("Нет таблицы для " + options_.discriminator + " = '" + string(value) + "'");
+        }
+        Route& route = routes_[static_cast<size_t>(index)];
+        if (!route.ready.load(memory_order_acquire)) {
+            lock_guard<mutex> lock(openMutex_);
+            if (!route.ready.load(memory_order_relaxed)) {
+                open(route, kTables[index].name);
+                route.ready.store(true, memory_order_release);
+            }
+        }
+        return route;
+    }
+
+    void open(Route& route, string_view name) {
+        string table(name);
+        auto it = schemas_.find(table);
+        if (it == schemas_.end()) {
+            throw invalid_argument("Таблица '" + table + "' отсутствует в базе данных.");
+        }
+        route.columns = &it->second;
+        route.index.clear();
+        bool found = false;
+        for (size_t i = 0; i < route.columns->size(); ++i) {
+            route.index.emplace((*route.columns)[i].first, i);
+            if ((*route.columns)[i].first == options_.discriminator) {
+                route.discriminator = i;
+                found = true;
+            }
+        }
+        if (!found && options_.format != IngestFormat::JsonLines) {
+            throw invalid_argument("В таблице '" + table + "' нет поля " + options_.discriminator);
+        }
+        const TblCol& columns = *route.columns;
+        route.batcher = make_unique<TableBatcher>(table, columns, options_.limits,
+                                                  [this, &columns](const string& table_name, const Block& block) {
+                                                      insertOrSpool(pool_, spool_, table_name, columns, block);
+                                                  },
+                                                  partitionKeyFor(options_, table, columns));
+    }
+
+    // Дискриминатор может нести имя таблицы: это строковый столбец или поле JSON вне схем
+    bool discriminatorIsText() const {
+        for (const TableDef& table : getSchemas()) {
+            for (const ColumnDef& column : table.columns) {
+                if (column.name == options_.discriminator) {
+                    return typeDesc(typeId(column.type)).base == BaseType::String;
+                }
+            }
+        }
+        return true;
+    }
+
+    size_t discriminatorPosition() const {
+        for (const TableDef& table : getSchemas()) {
+            for (size_t i = 0; i < table.columns.size(); ++i) {
+                if (table.columns[i].name == options_.discriminator) {
+                    return i;
+                }
+            }
+        }
+        throw invalid_argument("Поле " + options_.discriminator + " не найдено ни в одной таблице");
+    }
+
+    void add(Route& route, const vector<string_view>& row) {
+        route.batcher->add(row);
+        route.rows.fetch_add(1, memory_order_relaxed);
+    }
+
+    ConnectionPool& pool_;
+    Spool* spool_;
+    const unordered_map<string, TblCol>& schemas_;
+    const IngestOptions& options_;
+    unordered_map<string, int, StringViewHash, equal_to<>> routeByValue_;
+    array<Route, size(kTables)> routes_;
+    mutex openMutex_;
+    size_t position_ = 0;
+};
+
+#endif // ROUTER_H
@@ -1,435 +1,617 @@
 #ifndef SCHEMAS_H
 #define SCHEMAS_H
 
-#include <vector>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
 using Col = pair<string, string>;
 using TblCol = vector<Col>;
 
+// Типы столбцов, встречающиеся в эталонных схемах
+enum class ChType : uint8_t {
+    DateTime64_3,
+    UInt32,
+    NullableUInt8,
+    NullableUInt16,
+    NullableUInt32,
+    NullableUInt64,
+    NullableString,
+    NullableIPv4,
+    NullableIPv6,
+    NullableDateTime64_3,
+};
+
+// Имя типа в том виде, в котором его возвращает system.columns
+constexpr string_view typeName(ChType type) {
+    switch (type) {
+        case ChType::DateTime64_3: return "DateTime64(3)";
+        case ChType::UInt32: return "UInt32";
+        case ChType::NullableUInt8: return "Nullable(UInt8)";
+        case ChType::NullableUInt16: return "Nullable(UInt16)";
+        case ChType::NullableUInt32: return "Nullable(UInt32)";
+        case ChType::NullableUInt64: return "Nullable(UInt64)";
+        case ChType::NullableString: return "Nullable(String)";
+        case ChType::NullableIPv4: return "Nullable(IPv4)";
+        case ChType::NullableIPv6: return "Nullable(IPv6)";
+        case ChType::NullableDateTime64_3: return "Nullable(DateTime64(3))";
+    }
+    return "";
+}
+
+struct ColumnDef {
+    string_view name;
+    ChType type;
+};
+
+struct TableDef {
+    string_view name;
+    span<const ColumnDef> columns;
+};
+
+// Эталонные схемы таблиц
+inline constexpr ColumnDef t_accessattributes_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"ownerpermissions", ChType::NullableString},
+    {"operationresult", ChType::NullableUInt8},
+    {"actiontype", ChType::NullableUInt8},
+    {"objectid", ChType::NullableString},
+    {"grouppermissions", ChType::NullableString},
+    {"classifyinglabel", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_applicationfiltration_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"webserverversion", ChType::NullableUInt32},
+    {"fwversion", ChType::NullableUInt32},
+    {"httpversion", ChType::NullableString},
+    {"domainname", ChType::NullableString},
+    {"sessionid", ChType::NullableUInt64},
+    {"signatureid", ChType::NullableUInt64},
+    {"answercode", ChType::NullableUInt64},
+    {"httpmethod", ChType::NullableUInt8},
+    {"webservername", ChType::NullableString},
+    {"userapplication", ChType::NullableString},
+    {"portdst", ChType::NullableUInt16},
+    {"proxyserverport", ChType::NullableUInt16},
+    {"addrsrcquery4", ChType::NullableIPv4},
+    {"addrsrcquery6", ChType::NullableIPv6},
+    {"proxyserveraddr4", ChType::NullableIPv4},
+    {"proxyserveraddr6", ChType::NullableIPv6},
+    {"attacktype", ChType::NullableString},
+    {"resourcesourceuid", ChType::NullableString},
+    {"portsrc", ChType::NullableUInt16},
+    {"resourceuid", ChType::NullableString},
+    {"actiontype", ChType::NullableUInt8},
+    {"bytestx", ChType::NullableUInt64},
+    {"bytesrx", ChType::NullableUInt64},
+    {"geo", ChType::NullableString},
+    {"iinteractionmarker", ChType::NullableString},
+    {"modifyingresult", ChType::NullableUInt8},
+    {"vulnid", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_configuration_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"istversion", ChType::NullableUInt32},
+    {"istcomponent", ChType::NullableString},
+    {"operationresult", ChType::NullableUInt8},
+    {"configparam", ChType::NullableString},
+    {"configparamnew", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_denialofservice_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"attacksource4", ChType::NullableIPv4},
+    {"attacksource6", ChType::NullableIPv6},
+    {"attackcode", ChType::NullableUInt64},
+    {"attackname", ChType::NullableString},
+    {"channelutilization", ChType::NullableUInt8},
+    {"attackspeed", ChType::NullableUInt32},
+    {"packetscount", ChType::NullableUInt64},
+    {"portsrc", ChType::NullableUInt16},
+    {"portdst", ChType::NullableUInt16},
+    {"protocol", ChType::NullableUInt8},
+    {"actiontype", ChType::NullableUInt8},
+    {"attackstarted", ChType::NullableDateTime64_3},
+    {"attackduration", ChType::NullableUInt32},
+    {"attackcategory", ChType::NullableString},
+    {"ttl", ChType::NullableUInt64},
+    {"packetsize", ChType::NullableUInt64},
+};
+
+inline constexpr ColumnDef t_disarmed_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"istname", ChType::NullableString},
+    {"disarmreason", ChType::NullableString},
+    {"istversion", ChType::NullableUInt32},
+    {"disarmduration", ChType::NullableUInt32},
+    {"eventdescription", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_fdb_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"mac", ChType::NullableString},
+    {"virtualnetworkid", ChType::NullableUInt32},
+    {"switchportno", ChType::NullableUInt8},
+    {"actiontype", ChType::NullableUInt8},
+    {"resourcerecordtype", ChType::NullableString},
+    {"operationresult", ChType::NullableUInt8},
+    {"macinterfacecount", ChType::NullableUInt8},
+    {"virtualnetworkname", ChType::NullableString},
+    {"interfacedescription", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_filtrationmanagement_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"fwcomponent", ChType::NullableUInt8},
+    {"fwversion", ChType::NullableUInt32},
+    {"operationresult", ChType::NullableUInt8},
+    {"actiontype", ChType::NullableUInt8},
+    {"configparam", ChType::NullableString},
+    {"configparamnew", ChType::NullableString},
+    {"adminaddr4", ChType::NullableIPv4},
+    {"adminaddr6", ChType::NullableIPv6},
+    {"statusfwneedreboot", ChType::NullableUInt8},
+};
+
+inline constexpr ColumnDef t_hostattack_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"processname", ChType::NullableString},
+    {"portsrc", ChType::NullableUInt16},
+    {"portdst", ChType::NullableUInt16},
+    {"resourceuid", ChType::NullableString},
+    {"attackclass", ChType::NullableString},
+    {"attacksignature", ChType::NullableString},
+    {"protocol", ChType::NullableUInt8},
+    {"addrsrc4", ChType::NullableIPv4},
+    {"addrsrc6", ChType::NullableIPv6},
+    {"addrdst4", ChType::NullableIPv4},
+    {"addrdst6", ChType::NullableIPv6},
+    {"actiontype", ChType::NullableUInt8},
+    {"macsrc", ChType::NullableString},
+    {"macdst", ChType::NullableUInt64},
+    {"ttl", ChType::NullableUInt64},
+    {"sensorid", ChType::NullableString},
+    {"vulnid", ChType::NullableString},
+    {"packetscount", ChType::NullableUInt64},
+    {"httpmethod", ChType::NullableUInt8},
+    {"ifacename", ChType::NullableString},
+    {"attackdescription", ChType::NullableString},
+    {"packetsize", ChType::NullableUInt64},
+    {"packetpayload", ChType::NullableString},
+    {"packetheaderflag", ChType::NullableUInt8},
+};
+
+inline constexpr ColumnDef t_hostfiltration_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"flowdirection", ChType::NullableUInt8},
+    {"filterrulename", ChType::NullableString},
+    {"filterrulenumber", ChType::NullableUInt64},
+    {"iface", ChType::NullableString},
+    {"portsrc", ChType::NullableUInt16},
+    {"portdst", ChType::NullableUInt16},
+    {"protocol", ChType::NullableUInt8},
+    {"addrsrc4", ChType::NullableIPv4},
+    {"addrsrc6", ChType::NullableIPv6},
+    {"addrdst4", ChType::NullableIPv4},
+    {"addrdst6", ChType::NullableIPv6},
+    {"actiontype", ChType::NullableUInt8},
+    {"classifyinglabelpacket", ChType::NullableString},
+    {"resourceuid", ChType::NullableString},
+    {"macsrc", ChType::NullableUInt64},
+    {"macdst", ChType::NullableUInt64},
+    {"ttl", ChType::NullableUInt64},
+    {"httpmethod", ChType::NullableUInt8},
+    {"packetsize", ChType::NullableUInt64},
+};
+
+inline constexpr ColumnDef t_integrity_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"resourcename", ChType::NullableString},
+    {"controlmethod", ChType::NullableString},
+    {"checksumactual", ChType::NullableString},
+    {"objecttype", ChType::NullableString},
+    {"reactiontype", ChType::NullableUInt8},
+    {"checksumreference", ChType::NullableString},
+    {"checksumalgoname", ChType::NullableUInt8},
+    {"istintegrityversion", ChType::NullableUInt32},
+    {"integrityreferencecreation", ChType::NullableDateTime64_3},
+    {"checkintegritytaskname", ChType::NullableString},
+    {"istintegrityname", ChType::NullableString},
+    {"checkintegritytaskid", ChType::NullableUInt64},
+    {"eventdescription", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_journaling_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"actiontype", ChType::NullableUInt8},
+    {"journaltype", ChType::NullableUInt8},
+    {"operationresult", ChType::NullableUInt8},
+    {"configparam", ChType::NullableString},
+    {"configparamnew", ChType::NullableString},
+    {"adminaddr4", ChType::NullableIPv4},
+    {"adminaddr6", ChType::NullableIPv6},
+};
+
+inline constexpr ColumnDef t_journalrecords_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"actiontype", ChType::NullableUInt8},
+    {"journaltype", ChType::NullableUInt8},
+    {"operationresult", ChType::NullableUInt8},
+    {"configparam", ChType::NullableString},
+    {"configparamnew", ChType::NullableString},
+    {"adminaddr4", ChType::NullableIPv4},
+    {"adminaddr6", ChType::NullableIPv6},
+};
+
+inline constexpr ColumnDef t_macaddressing_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"macnew", ChType::NullableUInt64},
+    {"macold", ChType::NullableUInt64},
+    {"operationresult", ChType::NullableUInt8},
+    {"actiontype", ChType::NullableUInt8},
+    {"macoui", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_msgstats_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"softwarecomponentname", ChType::NullableString},
+    {"msgwrote", ChType::NullableUInt64},
+    {"byteswrote", ChType::NullableUInt64},
+    {"msgtransf", ChType::NullableUInt64},
+    {"bytestransf", ChType::NullableUInt64},
+    {"msglost", ChType::NullableUInt64},
+    {"byteslost", ChType::NullableUInt64},
+};
+
+inline constexpr ColumnDef t_networkaddressing_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"paramnetworkaddressnew4", ChType::NullableIPv4},
+    {"paramnetworkaddressnew6", ChType::NullableIPv6},
+    {"paramnetworkaddressold4", ChType::NullableIPv4},
+    {"paramnetworkaddressold6", ChType::NullableIPv6},
+    {"operationresult", ChType::NullableUInt8},
+    {"actiontype", ChType::NullableUInt8},
+    {"paramnetworksnew", ChType::NullableString},
+    {"paramnetworksold", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_networkattack_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"sensorid", ChType::NullableString},
+    {"attackclass", ChType::NullableString},
+    {"attacksignature", ChType::NullableString},
+    {"protocol", ChType::NullableUInt8},
+    {"addrsrc4", ChType::NullableIPv4},
+    {"addrsrc6", ChType::NullableIPv6},
+    {"addrdst4", ChType::NullableIPv4},
+    {"addrdst6", ChType::NullableIPv6},
+    {"actiontype", ChType::NullableUInt8},
+    {"macsrc", ChType::NullableUInt64},
+    {"macdst", ChType::NullableUInt64},
+    {"ttl", ChType::NullableUInt64},
+    {"vulnid", ChType::NullableString},
+    {"httpmethod", ChType::NullableUInt8},
+    {"packetscount", ChType::NullableUInt64},
+    {"ifacename", ChType::NullableString},
+    {"attackdescription", ChType::NullableString},
+    {"packetsize", ChType::NullableUInt64},
+    {"packetpayload", ChType::NullableString},
+    {"packetheaderflag", ChType::NullableUInt8},
+};
+
+inline constexpr ColumnDef t_networkfiltration_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"filterrulename", ChType::NullableString},
+    {"filterrulenumber", ChType::NullableUInt64},
+    {"iface", ChType::NullableString},
+    {"portsrc", ChType::NullableUInt16},
+    {"portdst", ChType::NullableUInt16},
+    {"protocol", ChType::NullableUInt8},
+    {"addrsrc4", ChType::NullableIPv4},
+    {"addrsrc6", ChType::NullableIPv6},
+    {"addrdst4", ChType::NullableIPv4},
+    {"addrdst6", ChType::NullableIPv6},
+    {"actiontype", ChType::NullableUInt8},
+    {"classifyinglabelpacket", ChType::NullableString},
+    {"resourceuid", ChType::NullableString},
+    {"macsrc", ChType::NullableUInt64},
+    {"macdst", ChType::NullableUInt64},
+    {"ttl", ChType::NullableUInt64},
+    {"httpmethod", ChType::NullableUInt8},
+    {"packetsize", ChType::NullableUInt64},
+};
+
+inline constexpr ColumnDef t_objectauth_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"authstatus", ChType::NullableString},
+    {"objectid", ChType::NullableString},
+    {"accountid", ChType::NullableString},
+    {"deviceserialno", ChType::NullableString},
+    {"processid", ChType::NullableUInt64},
+    {"seanceid", ChType::NullableUInt64},
+    {"processpath", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_objectident_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"objectid", ChType::NullableString},
+    {"identstatus", ChType::NullableString},
+    {"accountid", ChType::NullableString},
+    {"deviceserialno", ChType::NullableString},
+    {"processid", ChType::NullableUInt64},
+    {"seanceid", ChType::NullableUInt64},
+    {"processpath", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_securityfunctions_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"istname", ChType::NullableString},
+    {"istcomponent", ChType::NullableString},
+    {"istversion", ChType::NullableUInt32},
+    {"operationresult", ChType::NullableUInt8},
+    {"actiontype", ChType::NullableUInt8},
+    {"configparam", ChType::NullableString},
+    {"configparamnew", ChType::NullableString},
+    {"adminaddr4", ChType::NullableIPv4},
+    {"adminaddr6", ChType::NullableIPv6},
+};
+
+inline constexpr ColumnDef t_softwarecontrol_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"processparentid", ChType::NullableUInt64},
+    {"processparentname", ChType::NullableString},
+    {"processid", ChType::NullableUInt64},
+    {"processpath", ChType::NullableString},
+    {"actiontype", ChType::NullableUInt8},
+    {"checksumalgoname", ChType::NullableUInt8},
+    {"executingfileversion", ChType::NullableUInt32},
+    {"processtimeuser", ChType::NullableUInt32},
+    {"processtimekernel", ChType::NullableUInt32},
+    {"classifyinglabelprocess", ChType::NullableString},
+    {"executingfilechecksum", ChType::NullableString},
+    {"executingfiledeveloper", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_softwaresettings_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"softwareversion", ChType::NullableUInt32},
+    {"softwarecomponentname", ChType::NullableString},
+    {"operationresult", ChType::NullableUInt8},
+    {"configparam", ChType::NullableString},
+    {"configparamnew", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_staticroutes_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"typeroute", ChType::NullableUInt8},
+    {"operationresult", ChType::NullableUInt8},
+    {"actiontype", ChType::NullableUInt8},
+    {"routemetric", ChType::NullableUInt64},
+    {"paramnetworkroutenew", ChType::NullableString},
+    {"paramnetworkrouteold", ChType::NullableString},
+    {"ifacegateway", ChType::NullableString},
+};
+
+inline constexpr ColumnDef t_subjectidentauth_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"userid", ChType::NullableString},
+    {"admincap", ChType::NullableUInt8},
+    {"operationresult", ChType::NullableUInt8},
+    {"addrsrcentry4", ChType::NullableIPv4},
+    {"addrsrcentry6", ChType::NullableIPv6},
+    {"processid", ChType::NullableUInt64},
+    {"seanceid", ChType::NullableUInt64},
+    {"processpath", ChType::NullableString},
+    {"portsrcentry", ChType::NullableUInt16},
+    {"entrytype", ChType::NullableUInt8},
+};
+
+inline constexpr ColumnDef t_systemtime_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"systemdatepidchanged", ChType::NullableUInt64},
+    {"systemdatenew", ChType::NullableDateTime64_3},
+    {"systemdateold", ChType::NullableDateTime64_3},
+    {"operationresult", ChType::NullableUInt8},
+    {"actiontype", ChType::NullableUInt8},
+    {"ntpserveraddr4", ChType::NullableIPv4},
+    {"ntpserveraddr6", ChType::NullableIPv6},
+};
+
+inline constexpr ColumnDef t_useraccounting_columns[] = {
+    {"datetime", ChType::DateTime64_3},
+    {"msgtype", ChType::UInt32},
+    {"severity", ChType::NullableUInt8},
+    {"lastlogin", ChType::NullableDateTime64_3},
+    {"pswdcheckparams", ChType::NullableUInt8},
+    {"accountexpiration", ChType::NullableDateTime64_3},
+    {"accountstatus", ChType::NullableUInt8},
+    {"actiontype", ChType::NullableUInt8},
+    {"accounttype", ChType::NullableUInt8},
+    {"userid", ChType::NullableString},
+    {"lastpasswordsetup", ChType::NullableDateTime64_3},
+    {"classifyinglabel", ChType::NullableString},
+    {"username", ChType::NullableString},
+    {"groupid", ChType::NullableString},
+    {"userhomepath", ChType::NullableString},
+    {"logingranted", ChType::NullableDateTime64_3},
+    {"modifyingresult", ChType::NullableUInt8},
+    {"identifierdeviceid", ChType::NullableString},
+    {"groupsmembership", ChType::NullableString},
+};
+
+inline constexpr TableDef kTables[] = {
+    {"t_accessattributes", t_accessattributes_columns},
+    {"t_applicationfiltration", t_applicationfiltration_columns},
+    {"t_configuration", t_configuration_columns},
+    {"t_denialofservice", t_denialofservice_columns},
+    {"t_disarmed", t_disarmed_columns},
+    {"t_fdb", t_fdb_columns},
+    {"t_filtrationmanagement", t_filtrationmanagement_columns},
+    {"t_hostattack", t_hostattack_columns},
+    {"t_hostfiltration", t_hostfiltration_columns},
+    {"t_integrity", t_integrity_columns},
+    {"t_journaling", t_journaling_columns},
+    {"t_journalrecords", t_journalrecords_columns},
+    {"t_macaddressing", t_macaddressing_columns},
+    {"t_msgstats", t_msgstats_columns},
+    {"t_networkaddressing", t_networkaddressing_columns},
+    {"t_networkattack", t_networkattack_columns},
+    {"t_networkfiltration", t_networkfiltration_columns},
+    {"t_objectauth", t_objectauth_columns},
+    {"t_objectident", t_objectident_columns},
+    {"t_securityfunctions", t_securityfunctions_columns},
+    {"t_softwarecontrol", t_softwarecontrol_columns},
+    {"t_softwaresettings", t_softwaresettings_columns},
+    {"t_staticroutes", t_staticroutes_columns},
+    {"t_subjectidentauth", t_subjectidentauth_columns},
+    {"t_systemtime", t_systemtime_columns},
+    {"t_useraccounting", t_useraccounting_columns},
+};
+
+// Совершенный хеш по имени таблицы, подбираемый на этапе компиляции
+constexpr uint32_t tableNameHash(string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+inline constexpr size_t kTableSlotBits = 6;
+inline constexpr size_t kTableSlots = size_t{1} << kTableSlotBits;
+
+constexpr size_t tableSlot(string_view name, uint32_t seed) {
+    return ((tableNameHash(name) ^ seed) * 2654435761u) >> (32 - kTableSlotBits);
+}
+static_assert(size(kTables) <= kTableSlots);
+
+constexpr bool isPerfectSeed(uint32_t seed) {
+    array<bool, kTableSlots> used{};
+    for (const auto& table : kTables) {
+        size_t slot = tableSlot(table.name, seed);
+        if (used[slot]) {
+            return false;
+        }
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t findPerfectSeed() {
+    uint32_t seed = 0;
+    while (!isPerfectSeed(seed)) {
+        ++seed;
+    }
+    return seed;
+}
+
+inline constexpr uint32_t kTableSeed = findPerfectSeed();
+
+// Слот хеша -> индекс таблицы в kTables (-1 для пустого слота)
+inline constexpr array<int8_t, kTableSlots> kTableIndex = [] {
+    array<int8_t, kTableSlots> index{};
+    index.fill(-1);
+    for (size_t i = 0; i < size(kTables); ++i) {
+        index[tableSlot(kTables[i].name, kTableSeed)] = static_cast<int8_t>(i);
+    }
+    return index;
+}();
+
+// Индекс таблицы в kTables или -1, если эталонной схемы нет
+constexpr int tableIndex(string_view name) {
+    int index = kTableIndex[tableSlot(name, kTableSeed)];
+    return index >= 0 && kTables[index].name == name ? index : -1;
+}
+
 // Функция для получения эталонной схемы для таблицы
-unordered_map<string, TblCol> getSchemas() {
-    unordered_map<string, TblCol> schemas = {
-        {"t_accessattributes", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"ownerpermissions", "Nullable(String)"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"objectid", "Nullable(String)"},
-            {"grouppermissions", "Nullable(String)"},
-            {"classifyinglabel", "Nullable(String)"},
-        }},
-        {"t_applicationfiltration", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"webserverversion", "Nullable(UInt32)"},
-            {"fwversion", "Nullable(UInt32)"},
-            {"httpversion", "Nullable(String)"},
-            {"domainname", "Nullable(String)"},
-            {"sessionid", "Nullable(UInt64)"},
-            {"signatureid", "Nullable(UInt64)"},
-            {"answercode", "Nullable(UInt64)"},
-            {"httpmethod", "Nullable(UInt8)"},
-            {"webservername", "Nullable(String)"},
-            {"userapplication", "Nullable(String)"},
-            {"portdst", "Nullable(UInt16)"},
-            {"proxyserverport", "Nullable(UInt16)"},
-            {"addrsrcquery4", "Nullable(IPv4)"},
-            {"addrsrcquery6", "Nullable(IPv6)"},
-            {"proxyserveraddr4", "Nullable(IPv4)"},
-            {"proxyserveraddr6", "Nullable(IPv6)"},
-            {"attacktype", "Nullable(String)"},
-            {"resourcesourceuid", "Nullable(String)"},
-            {"portsrc", "Nullable(UInt16)"},
-            {"resourceuid", "Nullable(String)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"bytestx", "Nullable(UInt64)"},
-            {"bytesrx", "Nullable(UInt64)"},
-            {"geo", "Nullable(String)"},
-            {"iinteractionmarker", "Nullable(String)"},
-            {"modifyingresult", "Nullable(UInt8)"},
-            {"vulnid", "Nullable(String)"},
-        }},
-        {"t_configuration", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"istversion", "Nullable(UInt32)"},
-            {"istcomponent", "Nullable(String)"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"configparam", "Nullable(String)"},
-            {"configparamnew", "Nullable(String)"},
-        }},
-        {"t_denialofservice", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"attacksource4", "Nullable(IPv4)"},
-            {"attacksource6", "Nullable(IPv6)"},
-            {"attackcode", "Nullable(UInt64)"},
-            {"attackname", "Nullable(String)"},
-            {"channelutilization", "Nullable(UInt8)"},
-            {"attackspeed", "Nullable(UInt32)"},
-            {"packetscount", "Nullable(UInt64)"},
-            {"portsrc", "Nullable(UInt16)"},
-            {"portdst", "Nullable(UInt16)"},
-            {"protocol", "Nullable(UInt8)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"attackstarted", "Nullable(DateTime64(3))"},
-            {"attackduration", "Nullable(UInt32)"},
-            {"attackcategory", "Nullable(String)"},
-            {"ttl", "Nullable(UInt64)"},
-            {"packetsize", "Nullable(UInt64)"},
-        }},
-        {"t_disarmed", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"istname", "Nullable(String)"},
-            {"disarmreason", "Nullable(String)"},
-            {"istversion", "Nullable(UInt32)"},
-            {"disarmduration", "Nullable(UInt32)"},
-            {"eventdescription", "Nullable(String)"},
-        }},
-        {"t_fdb", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"mac", "Nullable(String)"},
-            {"virtualnetworkid", "Nullable(UInt32)"},
-            {"switchportno", "Nullable(UInt8)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"resourcerecordtype", "Nullable(String)"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"macinterfacecount", "Nullable(UInt8)"},
-            {"virtualnetworkname", "Nullable(String)"},
-            {"interfacedescription", "Nullable(String)"},
-        }},
-        {"t_filtrationmanagement", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"fwcomponent", "Nullable(UInt8)"},
-            {"fwversion", "Nullable(UInt32)"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"configparam", "Nullable(String)"},
-            {"configparamnew", "Nullable(String)"},
-            {"adminaddr4", "Nullable(IPv4)"},
-            {"adminaddr6", "Nullable(IPv6)"},
-            {"statusfwneedreboot", "Nullable(UInt8)"},
-        }},
-        {"t_hostattack", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"processname", "Nullable(String)"},
-            {"portsrc", "Nullable(UInt16)"},
-            {"portdst", "Nullable(UInt16)"},
-            {"resourceuid", "Nullable(String)"},
-            {"attackclass", "Nullable(String)"},
-            {"attacksignature", "Nullable(String)"},
-            {"protocol", "Nullable(UInt8)"},
-            {"addrsrc4", "Nullable(IPv4)"},
-            {"addrsrc6", "Nullable(IPv6)"},
-            {"addrdst4", "Nullable(IPv4)"},
-            {"addrdst6", "Nullable(IPv6)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"macsrc", "Nullable(String)"},
-            {"macdst", "Nullable(UInt64)"},
-            {"ttl", "Nullable(UInt64)"},
-            {"sensorid", "Nullable(String)"},
-            {"vulnid", "Nullable(String)"},
-            {"packetscount", "Nullable(UInt64)"},
-            {"httpmethod", "Nullable(UInt8)"},
-            {"ifacename", "Nullable(String)"},
-            {"attackdescription", "Nullable(String)"},
-            {"packetsize", "Nullable(UInt64)"},
-            {"packetpayload", "Nullable(String)"},
-            {"packetheaderflag", "Nullable(UInt8)"},
-        }},
-        {"t_hostfiltration", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"flowdirection", "Nullable(UInt8)"},
-            {"filterrulename", "Nullable(String)"},
-            {"filterrulenumber", "Nullable(UInt64)"},
-            {"iface", "Nullable(String)"},
-            {"portsrc", "Nullable(UInt16)"},
-            {"portdst", "Nullable(UInt16)"},
-            {"protocol", "Nullable(UInt8)"},
-            {"addrsrc4", "Nullable(IPv4)"},
-            {"addrsrc6", "Nullable(IPv6)"},
-            {"addrdst4", "Nullable(IPv4)"},
-            {"addrdst6", "Nullable(IPv6)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"classifyinglabelpacket", "Nullable(String)"},
-            {"resourceuid", "Nullable(String)"},
-            {"macsrc", "Nullable(UInt64)"},
-            {"macdst", "Nullable(UInt64)"},
-            {"ttl", "Nullable(UInt64)"},
-            {"httpmethod", "Nullable(UInt8)"},
-            {"packetsize", "Nullable(UInt64)"},
-        }},
-        {"t_integrity", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"resourcename", "Nullable(String)"},
-            {"controlmethod", "Nullable(String)"},
-            {"checksumactual", "Nullable(String)"},
-            {"objecttype", "Nullable(String)"},
-            {"reactiontype", "Nullable(UInt8)"},
-            {"checksumreference", "Nullable(String)"},
-            {"checksumalgoname", "Nullable(UInt8)"},
-            {"istintegrityversion", "Nullable(UInt32)"},
-            {"integrityreferencecreation", "Nullable(DateTime64(3))"},
-            {"checkintegritytaskname", "Nullable(String)"},
-            {"istintegrityname", "Nullable(String)"},
-            {"checkintegritytaskid", "Nullable(UInt64)"},
-            {"eventdescription", "Nullable(String)"},
-        }},
-        {"t_journaling", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"journaltype", "Nullable(UInt8)"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"configparam", "Nullable(String)"},
-            {"configparamnew", "Nullable(String)"},
-            {"adminaddr4", "Nullable(IPv4)"},
-            {"adminaddr6", "Nullable(IPv6)"},
-        }},
-        {"t_journalrecords", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"journaltype", "Nullable(UInt8)"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"configparam", "Nullable(String)"},
-            {"configparamnew", "Nullable(String)"},
-            {"adminaddr4", "Nullable(IPv4)"},
-            {"adminaddr6", "Nullable(IPv6)"},
-        }},
-        {"t_macaddressing", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"macnew", "Nullable(UInt64)"},
-            {"macold", "Nullable(UInt64)"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"macoui", "Nullable(String)"},
-        }},
-        {"t_msgstats", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"softwarecomponentname", "Nullable(String)"},
-            {"msgwrote", "Nullable(UInt64)"},
-            {"byteswrote", "Nullable(UInt64)"},
-            {"msgtransf", "Nullable(UInt64)"},
-            {"bytestransf", "Nullable(UInt64)"},
-            {"msglost", "Nullable(UInt64)"},
-            {"byteslost", "Nullable(UInt64)"},
-        }},
-        {"t_networkaddressing", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"paramnetworkaddressnew4", "Nullable(IPv4)"},
-            {"paramnetworkaddressnew6", "Nullable(IPv6)"},
-            {"paramnetworkaddressold4", "Nullable(IPv4)"},
-            {"paramnetworkaddressold6", "Nullable(IPv6)"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"paramnetworksnew", "Nullable(String)"},
-            {"paramnetworksold", "Nullable(String)"},
-        }},
-        {"t_networkattack", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"sensorid", "Nullable(String)"},
-            {"attackclass", "Nullable(String)"},
-            {"attacksignature", "Nullable(String)"},
-            {"protocol", "Nullable(UInt8)"},
-            {"addrsrc4", "Nullable(IPv4)"},
-            {"addrsrc6", "Nullable(IPv6)"},
-            {"addrdst4", "Nullable(IPv4)"},
-            {"addrdst6", "Nullable(IPv6)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"macsrc", "Nullable(UInt64)"},
-            {"macdst", "Nullable(UInt64)"},
-            {"ttl", "Nullable(UInt64)"},
-            {"vulnid", "Nullable(String)"},
-            {"httpmethod", "Nullable(UInt8)"},
-            {"packetscount", "Nullable(UInt64)"},
-            {"ifacename", "Nullable(String)"},
-            {"attackdescription", "Nullable(String)"},
-            {"packetsize", "Nullable(UInt64)"},
-            {"packetpayload", "Nullable(String)"},
-            {"packetheaderflag", "Nullable(UInt8)"},
-        }},
-        {"t_networkfiltration", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"filterrulename", "Nullable(String)"},
-            {"filterrulenumber", "Nullable(UInt64)"},
-            {"iface", "Nullable(String)"},
-            {"portsrc", "Nullable(UInt16)"},
-            {"portdst", "Nullable(UInt16)"},
-            {"protocol", "Nullable(UInt8)"},
-            {"addrsrc4", "Nullable(IPv4)"},
-            {"addrsrc6", "Nullable(IPv6)"},
-            {"addrdst4", "Nullable(IPv4)"},
-            {"addrdst6", "Nullable(IPv6)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"classifyinglabelpacket", "Nullable(String)"},
-            {"resourceuid", "Nullable(String)"},
-            {"macsrc", "Nullable(UInt64)"},
-            {"macdst", "Nullable(UInt64)"},
-            {"ttl", "Nullable(UInt64)"},
-            {"httpmethod", "Nullable(UInt8)"},
-            {"packetsize", "Nullable(UInt64)"},
-        }},
-        {"t_objectauth", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"authstatus", "Nullable(String)"},
-            {"objectid", "Nullable(String)"},
-            {"accountid", "Nullable(String)"},
-            {"deviceserialno", "Nullable(String)"},
-            {"processid", "Nullable(UInt64)"},
-            {"seanceid", "Nullable(UInt64)"},
-            {"processpath", "Nullable(String)"},
-        }},
-        {"t_objectident", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"objectid", "Nullable(String)"},
-            {"identstatus", "Nullable(String)"},
-            {"accountid", "Nullable(String)"},
-            {"deviceserialno", "Nullable(String)"},
-            {"processid", "Nullable(UInt64)"},
-            {"seanceid", "Nullable(UInt64)"},
-            {"processpath", "Nullable(String)"},
-        }},
-        {"t_securityfunctions", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"istname", "Nullable(String)"},
-            {"istcomponent", "Nullable(String)"},
-            {"istversion", "Nullable(UInt32)"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"configparam", "Nullable(String)"},
-            {"configparamnew", "Nullable(String)"},
-            {"adminaddr4", "Nullable(IPv4)"},
-            {"adminaddr6", "Nullable(IPv6)"},
-        }},
-        {"t_softwarecontrol", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"processparentid", "Nullable(UInt64)"},
-            {"processparentname", "Nullable(String)"},
-            {"processid", "Nullable(UInt64)"},
-            {"processpath", "Nullable(String)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"checksumalgoname", "Nullable(UInt8)"},
-            {"executingfileversion", "Nullable(UInt32)"},
-            {"processtimeuser", "Nullable(UInt32)"},
-            {"processtimekernel", "Nullable(UInt32)"},
-            {"classifyinglabelprocess", "Nullable(String)"},
-            {"executingfilechecksum", "Nullable(String)"},
-            {"executingfiledeveloper", "Nullable(String)"},
-        }},
-        {"t_softwaresettings", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"softwareversion", "Nullable(UInt32)"},
-            {"softwarecomponentname", "Nullable(String)"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"configparam", "Nullable(String)"},
-            {"configparamnew", "Nullable(String)"},
-        }},
-        {"t_staticroutes", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"typeroute", "Nullable(UInt8)"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"routemetric", "Nullable(UInt64)"},
-            {"paramnetworkroutenew", "Nullable(String)"},
-            {"paramnetworkrouteold", "Nullable(String)"},
-            {"ifacegateway", "Nullable(String)"},
-        }},
-        {"t_subjectidentauth", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"userid", "Nullable(String)"},
-            {"admincap", "Nullable(UInt8)"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"addrsrcentry4", "Nullable(IPv4)"},
-            {"addrsrcentry6", "Nullable(IPv6)"},
-            {"processid", "Nullable(UInt64)"},
-            {"seanceid", "Nullable(UInt64)"},
-            {"processpath", "Nullable(String)"},
-            {"portsrcentry", "Nullable(UInt16)"},
-            {"entrytype", "Nullable(UInt8)"},
-        }},
-        {"t_systemtime", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"systemdatepidchanged", "Nullable(UInt64)"},
-            {"systemdatenew", "Nullable(DateTime64(3))"},
-            {"systemdateold", "Nullable(DateTime64(3))"},
-            {"operationresult", "Nullable(UInt8)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"ntpserveraddr4", "Nullable(IPv4)"},
-            {"ntpserveraddr6", "Nullable(IPv6)"},
-        }},
-        {"t_useraccounting", {
-            {"datetime", "DateTime64(3)"},
-            {"msgtype", "UInt32"},
-            {"severity", "Nullable(UInt8)"},
-            {"lastlogin", "Nullable(DateTime64(3))"},
-            {"pswdcheckparams", "Nullable(UInt8)"},
-            {"accountexpiration", "Nullable(DateTime64(3))"},
-            {"accountstatus", "Nullable(UInt8)"},
-            {"actiontype", "Nullable(UInt8)"},
-            {"accounttype", "Nullable(UInt8)"},
-            {"userid", "Nullable(String)"},
-            {"lastpasswordsetup", "Nullable(DateTime64(3))"},
-            {"classifyinglabel", "Nullable(String)"},
-            {"username", "Nullable(String)"},
-            {"groupid", "Nullable(String)"},
-            {"userhomepath", "Nullable(String)"},
-            {"logingranted", "Nullable(DateTime64(3))"},
-            {"modifyingresult", "Nullable(UInt8)"},
-            {"identifierdeviceid", "Nullable(String)"},
-            {"groupsmembership", "Nullable(String)"},
-        }},
-    };
-    return schemas;
+constexpr const TableDef* findSchema(string_view name) {
+    int index = tableIndex(name);
+    return index >= 0 ? &kTables[index] : nullptr;
+}
+
+// Все эталонные схемы
+constexpr span<const TableDef> getSchemas() {
+    return kTables;
 }
 
+// Тип C++ для значения столбца заданного типа ClickHouse
+template <ChType Type> struct CppType;
+template <> struct CppType<ChType::DateTime64_3> { using type = int64_t; };
+template <> struct CppType<ChType::UInt32> { using type = uint32_t; };
+template <> struct CppType<ChType::NullableUInt8> { using type = optional<uint8_t>; };
+template <> struct CppType<ChType::NullableUInt16> { using type = optional<uint16_t>; };
+template <> struct CppType<ChType::NullableUInt32> { using type = optional<uint32_t>; };
+template <> struct CppType<ChType::NullableUInt64> { using type = optional<uint64_t>; };
+template <> struct CppType<ChType::NullableString> { using type = optional<string_view>; };
+template <> struct CppType<ChType::NullableIPv4> { using type = optional<uint32_t>; };
+template <> struct CppType<ChType::NullableIPv6> { using type = optional<array<uint8_t, 16>>; };
+template <> struct CppType<ChType::NullableDateTime64_3> { using type = optional<int64_t>; };
+
+template <size_t Table, size_t... I>
+auto makeTableRow(index_sequence<I...>) -> tuple<typename CppType<kTables[Table].columns[I].type>::type...>;
+
+// Строка таблицы в виде кортежа, выводимого из эталонной схемы: TableRow<tableIndex("t_fdb")>
+template <size_t Table>
+using TableRow = decltype(makeTableRow<Table>(make_index_sequence<kTables[Table].columns.size()>{}));
+
 #endif // SCHEMAS_H
@@ -0,0 +1,84 @@
+#ifndef SERVER_STATS_H
+#define SERVER_STATS_H
+
+#include <clickhouse/client.h>
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+#include "metrics.h"
+
+using namespace clickhouse;
+using namespace std;
+
+// Сбор того, что сервер сообщает о запросе: Progress (приращения прочитанных и записанных строк
+// и байт), Profile (итог результата SELECT) и ProfileEvents (процессорное время и память).
+// Создаётся до отправки запроса и живёт, пока запрос выполняется; итог пишется в метрики
+// таблицы при разрушении, в том числе после неудачной попытки
+class ServerQuery {
+public:
+    ServerQuery(Query& query, size_t table) : table_(table), started_(chrono::steady_clock::now()) {
+        query.OnProgress([this](const Progress& progress) {
+            stats_.readRows += progress.rows;
+            stats_.readBytes += progress.bytes;
+            stats_.writtenRows += progress.written_rows;
+            stats_.writtenBytes += progress.written_bytes;
+        });
+        query.OnProfile([this](const Profile& profile) {
+            stats_.resultRows = profile.rows;
+            stats_.resultBytes = profile.bytes;
+        });
+        query.OnProfileEvents([this](const Block& block) {
+            observeProfileEvents(block);
+            return true;
+        });
+    }
+
+    ServerQuery(const ServerQuery&) = delete;
+    ServerQuery& operator=(const ServerQuery&) = delete;
+
+    ~ServerQuery() {
+        stats_.elapsed = chrono::steady_clock::now() - started_;
+        recordServerStats(table_, stats_);
+    }
+
+private:
+    // Блок ProfileEvents: строки (host_name, current_time, thread_id, type, name, value) по потокам сервера.
+    // Счётчики времени приходят приращениями, память — текущим значением
+    void observeProfileEvents(const Block& block) {
+        int nameIndex = -1;
+        int valueIndex = -1;
+        for (size_t i = 0; i < block.GetColumnCount(); ++i) {
+            if (block.GetColumnName(i) == "name") {
+                nameIndex = static_cast<int>(i);
+            } else if (block.GetColumnName(i) == "value") {
+                valueIndex = static_cast<int>(i);
+            }
+        }
+        if (nameIndex < 0 || valueIndex < 0) {
+            return;
+        }
+        auto plainNames = block[nameIndex]->As<ColumnString>();
+        auto dictionaryNames = block[nameIndex]->As<ColumnLowCardinalityT<ColumnString>>();
+        auto signedValues = block[valueIndex]->As<ColumnInt64>();
+        auto unsignedValues = block[valueIndex]->As<ColumnUInt64>();
+        if ((!plainNames && !dictionaryNames) || (!signedValues && !unsignedValues)) {
+            return;
+        }
+        for (size_t row = 0; row < block.GetRowCount(); ++row) {
+            string_view name = plainNames ? plainNames->At(row) : dictionaryNames->At(row);
+            uint64_t value = signedValues ? static_cast<uint64_t>(max<int64_t>(signedValues->At(row), 0))
+                                          : unsignedValues->At(row);
+            if (name == "UserTimeMicroseconds" || name == "SystemTimeMicroseconds") {
+                stats_.cpuMicroseconds += value;
+            } else if (name == "MemoryTrackerPeakUsage" || name == "MemoryTrackerUsage") {
+                stats_.memoryPeak = max(stats_.memoryPeak, value);
+            }
+        }
+    }
+
+    size_t table_;
+    chrono::steady_clock::time_point started_;
+    ServerStats stats_;
+};
+
+#endif // SERVER_STATS_H
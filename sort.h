@@ -0,0 +1,67 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+using namespace std;
+
+// Устойчивая LSD-сортировка по 8 бит: на выходе order — перестановка строк по возрастанию ключа.
+// Сортируются пары (ключ, номер строки), чтобы каждый проход читал и писал память последовательно.
+// Гистограммы всех байтов строятся за один проход; байт, одинаковый у всех ключей (старшие байты
+// меток времени одного пакета), пропускается. Возвращает false, если ключи уже упорядочены.
+inline bool radixSortOrder(span<const int64_t> keys, vector<uint32_t>& order) {
+    size_t n = keys.size();
+    struct Item {
+        uint64_t key;
+        uint32_t row;
+    };
+
+    bool sorted = true;
+    for (size_t i = 1; i < n && sorted; ++i) {
+        sorted = keys[i - 1] <= keys[i];
+    }
+    if (sorted) {
+        return false;
+    }
+
+    vector<Item> items(n);
+    vector<Item> scratch(n);
+    array<array<uint32_t, 256>, 8> counts{};
+    for (size_t i = 0; i < n; ++i) {
+        // Инверсия знакового бита переводит порядок int64 в порядок uint64
+        uint64_t key = static_cast<uint64_t>(keys[i]) ^ (uint64_t(1) << 63);
+        items[i] = {key, static_cast<uint32_t>(i)};
+        for (size_t b = 0; b < 8; ++b) {
+            ++counts[b][(key >> (b * 8)) & 0xFF];
+        }
+    }
+
+    for (size_t b = 0; b < 8; ++b) {
+        auto& count = counts[b];
+        if (count[(items[0].key >> (b * 8)) & 0xFF] == n) {
+            continue;
+        }
+        uint32_t offset = 0;
+        for (auto& c : count) {
+            uint32_t next = offset + c;
+            c = offset;
+            offset = next;
+        }
+        for (const Item& item : items) {
+            scratch[count[(item.key >> (b * 8)) & 0xFF]++] = item;
+        }
+        items.swap(scratch);
+    }
+
+    order.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = items[i].row;
+    }
+    return true;
+}
+
+#endif // SORT_H
@@ -0,0 +1,520 @@
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "insert.h"
+#include "mapped_file.h"
+#include "pool.h"
+
+using namespace std;
+
+// CRC-32 (IEEE 802.3), табличный вариант
+inline uint32_t crc32(const void* data, size_t size, uint32_t crc = 0) {
+    static const array<uint32_t, 256> table = [] {
+        array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    const auto* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Заголовок записи спула; за ним следует тело длиной length
+struct SpoolRecordHeader {
+    static constexpr uint32_t kMagic = 0x324C5053;  // "SPL2"
+
+    uint32_t magic;
+    uint32_t length;
+    uint32_t crc;
+};
+
+inline void putU32(string& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline bool getU32(string_view& in, uint32_t& value) {
+    if (in.size() < sizeof(value)) {
+        return false;
+    }
+    memcpy(&value, in.data(), sizeof(value));
+    in.remove_prefix(sizeof(value));
+    return true;
+}
+
+inline constexpr uint32_t kSpoolNull = 0xFFFFFFFFu;
+
+// Тело записи: имя таблицы, токен дедупликации, число столбцов и строк, затем значения построчно
+// в текстовом виде (длина + байты, kSpoolNull для NULL) — их разбирает тот же BlockBuilder,
+// что и при обычной загрузке. Токен исходного пакета сохраняется, поэтому повтор после частично
+// успешной вставки не создаёт дубликатов.
+inline void encodeSpoolRecord(const string& table_name, const string& token, const TblCol& columns,
+                              const Block& block, string& out) {
+    vector<TypeId> types;
+    for (const auto& col : columns) {
+        types.push_back(internType(col.second));
+    }
+    putU32(out, static_cast<uint32_t>(table_name.size()));
+    out += table_name;
+    putU32(out, static_cast<uint32_t>(token.size()));
+    out += token;
+    putU32(out, static_cast<uint32_t>(block.GetColumnCount()));
+    putU32(out, static_cast<uint32_t>(block.GetRowCount()));
+    for (size_t row = 0; row < block.GetRowCount(); ++row) {
+        for (size_t i = 0; i < block.GetColumnCount(); ++i) {
+            size_t lengthAt = out.size();
+            putU32(out, 0);
+            if (formatValue(*block[i], types[i], row, out)) {
+                uint32_t length = static_cast<uint32_t>(out.size() - lengthAt - sizeof(uint32_t));
+                memcpy(out.data() + lengthAt, &length, sizeof(length));
+            } else {
+                memcpy(out.data() + lengthAt, &kSpoolNull, sizeof(kSpoolNull));
+            }
+        }
+    }
+}
+
+// Разбор тела записи: для каждой строки вызывается onRow с представлениями в отображённый сегмент
+inline bool decodeSpoolRecord(string_view in, string& table_name, string& token,
+                              const function<void(const vector<string_view>&)>& onRow) {
+    uint32_t nameLength = 0;
+    uint32_t tokenLength = 0;
+    uint32_t columnCount = 0;
+    uint32_t rowCount = 0;
+    if (!getU32(in, nameLength) || in.size() < nameLength) {
+        return false;
+    }
+    table_name.assign(in.data(), nameLength);
+    in.remove_prefix(nameLength);
+    if (!getU32(in, tokenLength) || in.size() < tokenLength) {
+        return false;
+    }
+    token.assign(in.data(), tokenLength);
+    in.remove_prefix(tokenLength);
+    if (!getU32(in, columnCount) || !getU32(in, rowCount)) {
+        return false;
+    }
+    vector<string_view> values(columnCount);
+    for (uint32_t row = 0; row < rowCount; ++row) {
+        for (uint32_t i = 0; i < columnCount; ++i) {
+            uint32_t length = 0;
+            if (!getU32(in, length)) {
+                return false;
+            }
+            if (length == kSpoolNull) {
+                values[i] = string_view();
+                continue;
+            }
+            if (in.size() < length) {
+                return false;
+            }
+            values[i] = in.substr(0, length);
+            in.remove_prefix(length);
+        }
+        onRow(values);
+    }
+    return true;
+}
+
+// Сегментированный журнал пакетов, которые не удалось вставить. Записи только дописываются;
+// fdatasync выполняется группами — по объёму или по времени, а также при ротации сегмента.
+class Spool {
+public:
+    static constexpr size_t kSegmentBytes = 64 * 1024 * 1024;
+    static constexpr size_t kSyncBytes = 4 * 1024 * 1024;
+    static constexpr chrono::milliseconds kSyncInterval{200};
+
+    explicit Spool(filesystem::path directory) : directory_(move(directory)) {
+        filesystem::create_directories(directory_);
+        for (const auto& segment : segments()) {
+            nextSegment_ = max(nextSegment_, segmentNumber(segment) + 1);
+        }
+    }
+
+    Spool(const Spool&) = delete;
+    Spool& operator=(const Spool&) = delete;
+
+    ~Spool() {
+        lock_guard<mutex> lock(mutex_);
+        closeLocked();
+    }
+
+    void append(const string& table_name, const string& token, const TblCol& columns, const Block& block) {
+        string record(sizeof(SpoolRecordHeader), '\0');
+        encodeSpoolRecord(table_name, token, columns, block, record);
+        SpoolRecordHeader header{SpoolRecordHeader::kMagic,
+                                 static_cast<uint32_t>(record.size() - sizeof(SpoolRecordHeader)),
+                                 crc32(record.data() + sizeof(SpoolRecordHeader), record.size() - sizeof(SpoolRecordHeader))};
+        memcpy(record.data(), &header, sizeof(header));
+
+        lock_guard<mutex> lock(mutex_);
+        if (fd_ < 0 || written_ + record.size() > kSegmentBytes) {
+            closeLocked();
+            openLocked();
+        }
+        writeAll(record.data(), record.size());
+        written_ += record.size();
+        unsynced_ += record.size();
+        auto now = chrono::steady_clock::now();
+        if (unsynced_ >= kSyncBytes || now - lastSync_ >= kSyncInterval) {
+            syncLocked();
+        }
+        spooledRows_ += block.GetRowCount();
+    }
+
+    // Закрытие текущего сегмента, чтобы его можно было воспроизвести
+    void roll() {
+        lock_guard<mutex> lock(mutex_);
+        closeLocked();
+    }
+
+    // Закрытые сегменты в порядке записи
+    vector<filesystem::path> closedSegments() {
+        lock_guard<mutex> lock(mutex_);
+        vector<filesystem::path> result;
+        for (auto& segment : segments()) {
+            if (segment != current_) {
+                result.push_back(segment);
+            }
+        }
+        return result;
+    }
+
+    bool empty() {
+        lock_guard<mutex> lock(mutex_);
+        return fd_ < 0 && segments().empty();
+    }
+
+    size_t spooledRows() const {
+        return spooledRows_.load();
+    }
+
+    filesystem::path quarantinePath() const {
+        return directory_ / "quarantine.log";
+    }
+
+    // Запись, которую сервер отклоняет не из-за сбоя связи, переносится в карантин в том же формате,
+    // чтобы не останавливать воспроизведение остальных; сегменты карантина не воспроизводятся
+    void quarantine(string_view record) {
+        lock_guard<mutex> lock(quarantineMutex_);
+        filesystem::path path = quarantinePath();
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw system_error(errno, generic_category(), "Не удалось открыть карантин спула " + path.string());
+        }
+        bool ok = ::write(fd, record.data(), record.size()) == static_cast<ssize_t>(record.size()) && fdatasync(fd) == 0;
+        int error = errno;
+        ::close(fd);
+        if (!ok) {
+            throw system_error(error, generic_category(), "Ошибка записи в карантин спула " + path.string());
+        }
+        quarantinedRecords_++;
+    }
+
+    size_t quarantinedRecords() const {
+        return quarantinedRecords_.load();
+    }
+
+    // Признак недоступности сервера: пока он установлен, пакеты сразу пишутся в спул
+    atomic<bool> serverDown{false};
+
+private:
+    static uint64_t segmentNumber(const filesystem::path& path) {
+        return stoull(path.stem().string().substr(strlen("spool-")));
+    }
+
+    vector<filesystem::path> segments() const {
+        map<uint64_t, filesystem::path> ordered;
+        for (const auto& entry : filesystem::directory_iterator(directory_)) {
+            string name = entry.path().filename().string();
+            if (name.starts_with("spool-") && name.ends_with(".log")) {
+                ordered.emplace(segmentNumber(entry.path()), entry.path());
+            }
+        }
+        vector<filesystem::path> result;
+        for (auto& [number, path] : ordered) {
+            result.push_back(path);
+        }
+        return result;
+    }
+
+    void openLocked() {
+        char name[32];
+        snprintf(name, sizeof(name), "spool-%010llu.log", static_cast<unsigned long long>(nextSegment_++));
+        current_ = directory_ / name;
+        fd_ = ::open(current_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw system_error(errno, generic_category(), "Не удалось создать сегмент спула " + current_.string());
+        }
+        written_ = 0;
+        lastSync_ = chrono::steady_clock::now();
+    }
+
+    void closeLocked() {
+        if (fd_ < 0) {
+            return;
+        }
+        syncLocked();
+        ::close(fd_);
+        fd_ = -1;
+        if (written_ == 0) {
+            filesystem::remove(current_);
+        }
+        current_.clear();
+    }
+
+    void syncLocked() {
+        if (unsynced_ > 0 && fdatasync(fd_) != 0) {
+            throw system_error(errno, generic_category(), "Ошибка fdatasync для сегмента спула");
+        }
+        unsynced_ = 0;
+        lastSync_ = chrono::steady_clock::now();
+    }
+
+    void writeAll(const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = ::write(fd_, data, size);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw system_error(errno, generic_category(), "Ошибка записи в спул");
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+
+    filesystem::path directory_;
+    mutex mutex_;
+    mutex quarantineMutex_;
+    atomic<size_t> quarantinedRecords_{0};
+    int fd_ = -1;
+    filesystem::path current_;
+    uint64_t nextSegment_ = 0;
+    size_t written_ = 0;
+    size_t unsynced_ = 0;
+    chrono::steady_clock::time_point lastSync_;
+    atomic<size_t> spooledRows_{0};
+};
+
+// Вставка пакета с повторами; если сервер недоступен, пакет сохраняется в спул, а не теряется
+inline void insertOrSpool(ConnectionPool& pool, Spool* spool, const string& table_name, const TblCol& columns,
+                          const Block& block) {
+    size_t table = metricsTable(table_name);
+    size_t bytes = 0;
+    string token = deduplicationToken(table_name, block, &bytes);
+    if (spool && spool->serverDown.load()) {
+        StageTimer timer(Stage::Spool);
+        spool->append(table_name, token, columns, block);
+        return;
+    }
+    size_t attempts = 0;
+    try {
+        StageTimer timer(Stage::Insert);
+        pool.run([&](Client& client) {
+            ++attempts;
+            insertBlock(client, table_name, block, token);
+        });
+    } catch (const exception& e) {
+        addCounter(table, Counter::Retries, attempts > 0 ? attempts - 1 : 0);
+        addCounter(table, Counter::Errors);
+        // Ошибка данных повторится и при воспроизведении, поэтому в спул идут только сбои связи
+        if (!spool || !isTransientError(e)) {
+            throw;
+        }
+        if (!spool->serverDown.exchange(true)) {
+            cerr << "Предупреждение: вставка в '" << table_name << "' не удалась (" << e.what()
+                 << "), пакеты сохраняются в спул." << endl;
+        }
+        StageTimer timer(Stage::Spool);
+        spool->append(table_name, token, columns, block);
+        return;
+    }
+    addCounter(table, Counter::Retries, attempts - 1);
+    addCounter(table, Counter::Rows, block.GetRowCount());
+    addCounter(table, Counter::Bytes, bytes);
+    addCounter(table, Counter::Batches);
+}
+
+// Фоновое воспроизведение спула: сегменты отображаются в память, записи проверяются по CRC,
+// каждая запись вставляется отдельным блоком со своим исходным токеном; полностью вставленный
+// сегмент удаляется, а прерванный повторяется с начала — уже вставленные записи сервер отбросит
+class SpoolReplayer {
+public:
+    using SchemaLookup = function<const TblCol*(const string& table_name)>;
+
+    SpoolReplayer(Spool& spool, ConnectionPool& pool, SchemaLookup schemas)
+        : spool_(spool), pool_(pool), schemas_(move(schemas)) {
+        worker_ = thread([this] { run(); });
+    }
+
+    SpoolReplayer(const SpoolReplayer&) = delete;
+    SpoolReplayer& operator=(const SpoolReplayer&) = delete;
+
+    ~SpoolReplayer() {
+        {
+            lock_guard<mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        worker_.join();
+    }
+
+    // Однократная попытка воспроизвести все сегменты, включая текущий; true, если спул пуст
+    bool drain() {
+        lock_guard<mutex> lock(replayMutex_);
+        spool_.roll();
+        for (const auto& segment : spool_.closedSegments()) {
+            if (!replaySegment(segment)) {
+                return false;
+            }
+        }
+        spool_.serverDown = false;
+        return spool_.empty();
+    }
+
+    size_t replayedRows() const {
+        return replayedRows_.load();
+    }
+
+private:
+    void run() {
+        chrono::milliseconds delay(500);
+        unique_lock<mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, delay, [this] { return stopping_; })) {
+            lock.unlock();
+            bool drained = false;
+            try {
+                drained = drain();
+            } catch (const exception& e) {
+                cerr << "Ошибка воспроизведения спула: " << e.what() << endl;
+            }
+            // Пока сервер недоступен, попытки становятся реже
+            delay = drained ? chrono::milliseconds(500) : min(delay * 2, chrono::milliseconds(30000));
+            lock.lock();
+        }
+    }
+
+    bool replaySegment(const filesystem::path& path) {
+        MappedFile segment(path.string());
+        string_view data = segment.data();
+        map<string, unique_ptr<BlockBuilder>> builders;
+        // Значения записи подряд по строкам: представления указывают в отображённый сегмент
+        vector<string_view> values;
+        size_t rows = 0;
+
+        try {
+            while (data.size() >= sizeof(SpoolRecordHeader)) {
+                SpoolRecordHeader header;
+                memcpy(&header, data.data(), sizeof(header));
+                if (header.magic != SpoolRecordHeader::kMagic ||
+                    data.size() - sizeof(header) < header.length) {
+                    // Недописанный хвост после аварийного завершения
+                    break;
+                }
+                string_view record = data.substr(0, sizeof(header) + header.length);
+                string_view body = record.substr(sizeof(header));
+                data.remove_prefix(record.size());
+                if (crc32(body.data(), body.size()) != header.crc) {
+                    cerr << "Предупреждение: повреждённая запись в " << path << " пропущена." << endl;
+                    continue;
+                }
+
+                string table_name;
+                string token;
+                BlockBuilder* builder = nullptr;
+                try {
+                    values.clear();
+                    size_t width = 0;
+                    bool ok = decodeSpoolRecord(body, table_name, token, [&](const vector<string_view>& row) {
+                        width = row.size();
+                        values.insert(values.end(), row.begin(), row.end());
+                    });
+                    if (!ok) {
+                        throw invalid_argument("запись не разобрана");
+                    }
+                    if (!values.empty()) {
+                        auto& slot = builders[table_name];
+                        if (!slot) {
+                            const TblCol* columns = schemas_(table_name);
+                            if (!columns) {
+                                throw invalid_argument("Неизвестная таблица в спуле: " + table_name);
+                            }
+                            slot = make_unique<BlockBuilder>(*columns);
+                        }
+                        builder = slot.get();
+                        if (width != builder->columns().size()) {
+                            throw invalid_argument("число столбцов записи не совпадает со схемой таблицы");
+                        }
+                        // Запись спула — целый пакет, поэтому столбцы UInt разбираются за один проход
+                        builder->appendRows(values);
+                    }
+                    if (builder) {
+                        Batch batch = builder->build();
+                        pool_.run([&](Client& client) { insertBlock(client, table_name, batch.block, token); });
+                        rows += batch.rows();
+                    }
+                } catch (const exception& e) {
+                    // Сбой связи прерывает сегмент до следующей попытки; прочие ошибки не пройдут и при повторе
+                    if (isTransientError(e)) {
+                        throw;
+                    }
+                    if (builder && builder->rows() > 0) {
+                        builder->build();
+                    }
+                    spool_.quarantine(record);
+                    cerr << "Предупреждение: запись таблицы '" << table_name << "' из " << path << " отклонена ("
+                         << e.what() << ") и перенесена в " << spool_.quarantinePath() << "." << endl;
+                }
+            }
+        } catch (const exception& e) {
+            cerr << "Воспроизведение " << path << " прервано: " << e.what() << endl;
+            return false;
+        }
+
+        filesystem::remove(path);
+        replayedRows_ += rows;
+        return true;
+    }
+
+    Spool& spool_;
+    ConnectionPool& pool_;
+    SchemaLookup schemas_;
+
+    mutex replayMutex_;
+    mutex mutex_;
+    condition_variable cv_;
+    bool stopping_ = false;
+    atomic<size_t> replayedRows_{0};
+    thread worker_;
+};
+
+#endif // SPOOL_H
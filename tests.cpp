@@ -0,0 +1,522 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "datetime.h"
+#include "ingest.h"
+#include "insert.h"
+#include "integers.h"
+#include "ip.h"
+#include "mapped_file.h"
+#include "ring.h"
+#include "sort.h"
+#include "spool.h"
+#include "types.h"
+
+using namespace std;
+
+// Модульные тесты: ./tests или ctest
+
+namespace {
+
+string formatTicks(int64_t ticks, unsigned precision) {
+    char buffer[32];
+    return string(buffer, formatDateTime64(ticks, precision, buffer));
+}
+
+array<uint8_t, 16> ipv6(initializer_list<uint8_t> bytes) {
+    array<uint8_t, 16> address{};
+    copy(bytes.begin(), bytes.end(), address.begin());
+    return address;
+}
+
+// Все строки входа, выделенные nextLine
+vector<string> splitLines(string_view data, bool quoteAware) {
+    ChunkSource source;
+    source.reset(data);
+    vector<string> lines;
+    string_view line;
+    while (nextLine(source, line, quoteAware)) {
+        lines.emplace_back(line);
+    }
+    return lines;
+}
+
+// Текстовые значения всех строк собранного блока
+vector<vector<string>> formatRows(const Block& block, const TblCol& columns) {
+    vector<vector<string>> rows(block.GetRowCount());
+    for (size_t row = 0; row < rows.size(); ++row) {
+        for (size_t i = 0; i < columns.size(); ++i) {
+            string value;
+            formatValue(*block[i], internType(columns[i].second), row, value);
+            rows[row].push_back(value);
+        }
+    }
+    return rows;
+}
+
+// Смещение --tz действует на весь процесс, поэтому тесты возвращают его к UTC
+struct UtcOffsetGuard {
+    explicit UtcOffsetGuard(int32_t seconds) {
+        inputUtcOffsetSeconds = seconds;
+    }
+
+    ~UtcOffsetGuard() {
+        inputUtcOffsetSeconds = 0;
+    }
+};
+
+}  // namespace
+
+TEST(DateTime64, ParsesLayoutVariants) {
+    int64_t ticks = 0;
+    ASSERT_TRUE(parseDateTime64("2024-04-01 00:00:00", 0, ticks));
+    EXPECT_EQ(ticks, 1711929600);
+    ASSERT_TRUE(parseDateTime64("2024-04-01T00:00:00", 3, ticks));
+    EXPECT_EQ(ticks, 1711929600000);
+    ASSERT_TRUE(parseDateTime64("2024-02-29 23:59:59", 0, ticks));
+    EXPECT_EQ(ticks, 1709251199);
+    ASSERT_TRUE(parseDateTime64("1969-12-31 23:59:59.5", 3, ticks));
+    EXPECT_EQ(ticks, -500);
+}
+
+TEST(DateTime64, ScalesFraction) {
+    int64_t ticks = 0;
+    ASSERT_TRUE(parseDateTime64("1970-01-01 00:00:01.7", 3, ticks));
+    EXPECT_EQ(ticks, 1700);
+    // Лишние знаки дроби отбрасываются, а не округляются
+    ASSERT_TRUE(parseDateTime64("1970-01-01 00:00:01.123456789", 3, ticks));
+    EXPECT_EQ(ticks, 1123);
+    ASSERT_TRUE(parseDateTime64("1970-01-01 00:00:01.123456789", 9, ticks));
+    EXPECT_EQ(ticks, 1123456789);
+    ASSERT_TRUE(parseDateTime64("1970-01-01 00:00:01.999", 0, ticks));
+    EXPECT_EQ(ticks, 1);
+}
+
+TEST(DateTime64, AppliesOffset) {
+    int64_t ticks = 0;
+    ASSERT_TRUE(parseDateTime64("2024-04-01 03:00:00+03:00", 0, ticks));
+    EXPECT_EQ(ticks, 1711929600);
+    ASSERT_TRUE(parseDateTime64("2024-03-31 19:00:00-0500", 0, ticks));
+    EXPECT_EQ(ticks, 1711929600);
+    ASSERT_TRUE(parseDateTime64("2024-04-01 02:00:00+02", 0, ticks));
+    EXPECT_EQ(ticks, 1711929600);
+    ASSERT_TRUE(parseDateTime64("2024-04-01T00:00:00.250Z", 3, ticks));
+    EXPECT_EQ(ticks, 1711929600250);
+}
+
+TEST(DateTime64, UsesInputOffsetOnlyForNaiveValues) {
+    UtcOffsetGuard guard(3 * 3600);
+    int64_t ticks = 0;
+    ASSERT_TRUE(parseDateTime64("2024-04-01 03:00:00", 0, ticks));
+    EXPECT_EQ(ticks, 1711929600);
+    ASSERT_TRUE(parseDateTime64("2024-04-01 00:00:00Z", 0, ticks));
+    EXPECT_EQ(ticks, 1711929600);
+}
+
+TEST(DateTime64, RejectsMalformed) {
+    int64_t ticks = 0;
+    for (string_view value : {"", "2024-04-01", "2024-04-01 00:00", "2024/04/01 00:00:00", "2024-13-01 00:00:00",
+                              "2024-00-01 00:00:00", "2023-02-29 00:00:00", "2024-04-31 00:00:00",
+                              "2024-04-01 24:00:00", "2024-04-01 00:60:00", "2024-04-01 00:00:60",
+                              "2024-04-01 00:00:00.", "2024-04-01 00:00:00 ", "2024-04-01 00:00:00Zx",
+                              "2024-04-01 00:00:00+3", "2024-04-01 00:00:00+24:00", "2024-04-01 00:00:00+03:60",
+                              "2024-04-01x00:00:00", "2O24-04-01 00:00:00"}) {
+        EXPECT_FALSE(parseDateTime64(value, 3, ticks)) << value;
+    }
+    EXPECT_FALSE(parseDateTime64("2024-04-01 00:00:00", 10, ticks));
+}
+
+TEST(DateTime64, FormatRoundTrip) {
+    mt19937_64 random(3);
+    for (unsigned precision : {0u, 3u, 6u, 9u}) {
+        for (int i = 0; i < 1000; ++i) {
+            int64_t ticks = static_cast<int64_t>(random() % (int64_t(1) << 50)) - (int64_t(1) << 49);
+            ticks /= kPow10[9 - precision];
+            string text = formatTicks(ticks, precision);
+            int64_t parsed = 0;
+            ASSERT_TRUE(parseDateTime64(text, precision, parsed)) << text;
+            EXPECT_EQ(parsed, ticks) << text;
+        }
+    }
+    EXPECT_EQ(formatTicks(1711929600123, 3), "2024-04-01 00:00:00.123");
+    EXPECT_EQ(formatTicks(-1, 3), "1969-12-31 23:59:59.999");
+    EXPECT_EQ(formatTicks(0, 0), "1970-01-01 00:00:00");
+}
+
+TEST(TypeParsing, DateTime64Arguments) {
+    TypeDesc desc = parseType("DateTime64(12)");
+    EXPECT_EQ(desc.base, BaseType::DateTime64);
+    EXPECT_EQ(desc.precision, 12);
+
+    desc = parseType("Nullable(DateTime64(6, 'Europe/Moscow'))");
+    EXPECT_TRUE(desc.nullable);
+    EXPECT_EQ(desc.precision, 6);
+    EXPECT_EQ(desc.timezone, "Europe/Moscow");
+
+    for (string_view type : {"DateTime64()", "DateTime64(3", "DateTime64(3, UTC)", "DateTime64(3,)", "DateTime64(x)",
+                             "DateTime64(3, '')", "DateTime64(999)"}) {
+        EXPECT_EQ(parseType(type).base, BaseType::Unknown) << type;
+    }
+}
+
+TEST(TypeParsing, DistinctTypesKeepTheirNames) {
+    TypeId first = internType("Decimal(10, 2)");
+    TypeId second = internType("Array(String)");
+    EXPECT_NE(first, second);
+    EXPECT_EQ(TypeRegistry::instance().name(second), "Array(String)");
+    EXPECT_EQ(internType("DateTime64(3)"), typeId(ChType::DateTime64_3));
+    EXPECT_NE(internType("DateTime64(3, 'UTC')"), typeId(ChType::DateTime64_3));
+}
+
+TEST(UInt, ParsesFullRange) {
+    uint8_t u8 = 0;
+    EXPECT_EQ(parseUInt("255", u8), ConvertError::None);
+    EXPECT_EQ(u8, 255);
+    uint32_t u32 = 0;
+    EXPECT_EQ(parseUInt("4294967295", u32), ConvertError::None);
+    EXPECT_EQ(u32, 4294967295u);
+    uint64_t u64 = 0;
+    EXPECT_EQ(parseUInt("18446744073709551615", u64), ConvertError::None);
+    EXPECT_EQ(u64, UINT64_MAX);
+    EXPECT_EQ(parseUInt("0", u64), ConvertError::None);
+    EXPECT_EQ(u64, 0u);
+}
+
+TEST(UInt, RejectsOverflowAndGarbage) {
+    uint8_t u8 = 0;
+    EXPECT_EQ(parseUInt("256", u8), ConvertError::Overflow);
+    EXPECT_EQ(parseUInt("300", u8), ConvertError::Overflow);
+    uint16_t u16 = 0;
+    EXPECT_EQ(parseUInt("65536", u16), ConvertError::Overflow);
+    uint32_t u32 = 0;
+    EXPECT_EQ(parseUInt("4294967296", u32), ConvertError::Overflow);
+    uint64_t u64 = 0;
+    EXPECT_EQ(parseUInt("18446744073709551616", u64), ConvertError::Overflow);
+    for (string_view value : {"", "-1", "+1", " 1", "1 ", "12a", "0x10", "1.0"}) {
+        EXPECT_EQ(parseUInt(value, u32), ConvertError::Invalid) << value;
+    }
+}
+
+TEST(UInt, ParsesColumn) {
+    vector<string_view> values = {"1", "", "65535", "0"};
+    uint16_t out[4] = {};
+    uint8_t nulls[4] = {};
+    ConvertError error = ConvertError::Invalid;
+    EXPECT_EQ(parseUIntColumn<uint16_t>(values, out, nulls, error), values.size());
+    EXPECT_EQ(error, ConvertError::None);
+    EXPECT_EQ(vector<uint16_t>(out, out + 4), (vector<uint16_t>{1, 0, 65535, 0}));
+    EXPECT_EQ(vector<uint8_t>(nulls, nulls + 4), (vector<uint8_t>{0, 1, 0, 0}));
+}
+
+TEST(UInt, ColumnStopsAtFirstError) {
+    vector<string_view> values = {"7", "8", "256", "x", "9"};
+    uint8_t out[5] = {};
+    uint8_t nulls[5] = {};
+    ConvertError error = ConvertError::None;
+    // Переполнение посреди столбца: значения до него уже записаны
+    EXPECT_EQ(parseUIntColumn<uint8_t>(values, out, nulls, error), 2u);
+    EXPECT_EQ(error, ConvertError::Overflow);
+    EXPECT_EQ(out[0], 7);
+    EXPECT_EQ(out[1], 8);
+
+    // Без nulls пустое значение не NULL, а ошибка
+    vector<string_view> withEmpty = {"1", ""};
+    uint32_t wide[2] = {};
+    EXPECT_EQ(parseUIntColumn<uint32_t>(withEmpty, wide, nullptr, error), 1u);
+    EXPECT_EQ(error, ConvertError::Invalid);
+    EXPECT_EQ(parseUIntColumn<uint32_t>(span<const string_view>(), wide, nullptr, error), 0u);
+    EXPECT_EQ(error, ConvertError::None);
+}
+
+TEST(IPv4, ParsesDottedQuad) {
+    uint32_t address = 0;
+    ASSERT_TRUE(parseIPv4("192.168.0.1", address));
+    EXPECT_EQ(address, 0xC0A80001u);
+    ASSERT_TRUE(parseIPv4("0.0.0.0", address));
+    EXPECT_EQ(address, 0u);
+    ASSERT_TRUE(parseIPv4("255.255.255.255", address));
+    EXPECT_EQ(address, 0xFFFFFFFFu);
+}
+
+TEST(IPv4, RejectsMalformed) {
+    uint32_t address = 0;
+    for (string_view value : {"", "1.2.3", "1.2.3.4.5", "256.0.0.1", "01.2.3.4", "1..3.4", "1.2.3.4 ", "a.b.c.d",
+                              "1.2.3.", ".1.2.3", "1.2.3.1000"}) {
+        EXPECT_FALSE(parseIPv4(value, address)) << value;
+    }
+}
+
+TEST(IPv6, ParsesCompressedForms) {
+    array<uint8_t, 16> address{};
+    ASSERT_TRUE(parseIPv6("::", address));
+    EXPECT_EQ(address, ipv6({}));
+    ASSERT_TRUE(parseIPv6("::1", address));
+    EXPECT_EQ(address, ipv6({0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1}));
+    ASSERT_TRUE(parseIPv6("2001:DB8::ff00:42", address));
+    EXPECT_EQ(address, ipv6({0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0x00, 0x00, 0x42}));
+    ASSERT_TRUE(parseIPv6("fe80::", address));
+    EXPECT_EQ(address, ipv6({0xfe, 0x80}));
+    ASSERT_TRUE(parseIPv6("1:2:3:4:5:6:7:8", address));
+    EXPECT_EQ(address, ipv6({0, 1, 0, 2, 0, 3, 0, 4, 0, 5, 0, 6, 0, 7, 0, 8}));
+}
+
+TEST(IPv6, ParsesEmbeddedIPv4) {
+    array<uint8_t, 16> address{};
+    ASSERT_TRUE(parseIPv6("::ffff:1.2.3.4", address));
+    EXPECT_EQ(address, ipv6({0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 1, 2, 3, 4}));
+    ASSERT_TRUE(parseIPv6("64:ff9b::192.0.2.33", address));
+    EXPECT_EQ(address, ipv6({0, 0x64, 0xff, 0x9b, 0, 0, 0, 0, 0, 0, 0, 0, 192, 0, 2, 33}));
+    ASSERT_TRUE(parseIPv6("0:0:0:0:0:ffff:10.0.0.1", address));
+    EXPECT_EQ(address, ipv6({0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 10, 0, 0, 1}));
+}
+
+TEST(IPv6, RejectsMalformed) {
+    array<uint8_t, 16> address{};
+    for (string_view value : {"", ":", ":::", "1::2::3", ":1::", "1:", "1:2:3:4:5:6:7", "1:2:3:4:5:6:7:8:9",
+                              "1:2:3:4:5:6:7:8::", "12345::", "g::1", "::ffff:1.2.3", "::ffff:1.2.3.4:5",
+                              "1:2:3:4:5:6:7:1.2.3.4", "::1.2.3.256"}) {
+        EXPECT_FALSE(parseIPv6(value, address)) << value;
+    }
+}
+
+TEST(NextLine, KeepsQuotedNewlines) {
+    string_view data = "a,\"x\ny\"\r\nb\n\n\nc,\"\"\"\n\"\nd";
+    EXPECT_EQ(splitLines(data, true), (vector<string>{"a,\"x\ny\"", "b", "c,\"\"\"\n\"", "d"}));
+    EXPECT_EQ(splitLines(data, false), (vector<string>{"a,\"x", "y\"", "b", "c,\"\"\"", "\"", "d"}));
+}
+
+TEST(NextLine, UnterminatedQuoteTakesRest) {
+    EXPECT_EQ(splitLines("a\n\"b\nc", true), (vector<string>{"a", "\"b\nc"}));
+    EXPECT_TRUE(splitLines("\n\r\n\n", true).empty());
+}
+
+TEST(RadixSort, MatchesStableSort) {
+    mt19937_64 random(5);
+    for (size_t n : {2u, 3u, 100u, 4096u}) {
+        for (int spread : {0, 1, 2}) {
+            vector<int64_t> keys(n);
+            for (auto& key : keys) {
+                // Небольшой разброс даёт много равных ключей и пропуск одинаковых байтов
+                key = spread == 0 ? static_cast<int64_t>(random() % 8)
+                    : spread == 1 ? 1711929600000 + static_cast<int64_t>(random() % 86400000)
+                                  : static_cast<int64_t>(random());
+            }
+            vector<uint32_t> expected(n);
+            for (uint32_t i = 0; i < n; ++i) {
+                expected[i] = i;
+            }
+            stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+            vector<uint32_t> order;
+            bool sorted = is_sorted(keys.begin(), keys.end());
+            EXPECT_EQ(radixSortOrder(keys, order), !sorted);
+            if (!sorted) {
+                EXPECT_EQ(order, expected) << "n=" << n << " spread=" << spread;
+            }
+        }
+    }
+}
+
+TEST(RadixSort, OrdersNegativeKeys) {
+    vector<int64_t> keys = {5, -1, INT64_MIN, 0, INT64_MAX, -1};
+    vector<uint32_t> order;
+    ASSERT_TRUE(radixSortOrder(keys, order));
+    EXPECT_EQ(order, (vector<uint32_t>{2, 1, 5, 3, 0, 4}));
+    vector<int64_t> ordered = {1, 2, 2, 3};
+    EXPECT_FALSE(radixSortOrder(ordered, order));
+}
+
+TEST(BlockBuilder, RejectedRowLeavesNoTrace) {
+    TblCol columns = {{"datetime", "DateTime64(3)"}, {"host", "Nullable(String)"}, {"id", "UInt32"}};
+    BlockBuilder builder(columns);
+    builder.sortBy("datetime");
+    builder.appendRow(vector<string>{"2024-04-01 00:00:02Z", "b", "2"});
+    // Ошибка в последнем столбце: первые два значения уже разобраны, но не должны попасть в блок
+    EXPECT_THROW(builder.appendRow(vector<string>{"2024-04-01 00:00:01Z", "x", "-1"}), invalid_argument);
+    builder.appendRow(vector<string>{"2024-04-01 00:00:00Z", "", "0"});
+    EXPECT_EQ(builder.rows(), 2u);
+
+    Batch batch = builder.build();
+    EXPECT_EQ(formatRows(batch.block, columns), (vector<vector<string>>{{"2024-04-01 00:00:00.000Z", "", "0"},
+                                                                        {"2024-04-01 00:00:02.000Z", "b", "2"}}));
+}
+
+TEST(BlockBuilder, AppendRowsConvertsUIntColumns) {
+    TblCol columns = {{"id", "UInt32"}, {"port", "Nullable(UInt16)"}, {"host", "Nullable(String)"}};
+    vector<vector<string>> rows;
+    for (size_t row = 0; row < 600; ++row) {
+        rows.push_back({to_string(row * 1000), row % 3 == 0 ? "" : to_string(row), "h" + to_string(row % 5)});
+    }
+    // Переполнение UInt16 во втором блоке по 256 значений
+    rows[300][1] = "70000";
+    vector<string_view> values;
+    for (const auto& row : rows) {
+        values.insert(values.end(), row.begin(), row.end());
+    }
+
+    BlockBuilder builder(columns);
+    EXPECT_THROW(builder.appendRows(values), invalid_argument);
+    EXPECT_EQ(builder.rows(), 300u);
+    builder.appendRows(span<const string_view>(values).subspan(301 * columns.size()));
+    EXPECT_EQ(builder.rows(), 599u);
+
+    Batch batch = builder.build();
+    vector<vector<string>> expected(rows.begin(), rows.begin() + 300);
+    expected.insert(expected.end(), rows.begin() + 301, rows.end());
+    EXPECT_EQ(formatRows(batch.block, columns), expected);
+    EXPECT_THROW(builder.appendRows(span<const string_view>(values).first(4)), invalid_argument);
+}
+
+TEST(BoundedRing, KeepsFifoOrderAndCapacity) {
+    BoundedRing<int> ring(3);
+    EXPECT_EQ(ring.capacity(), 4u);
+    for (int i = 0; i < 4; ++i) {
+        int value = i;
+        EXPECT_TRUE(ring.tryPush(value));
+    }
+    int extra = 4;
+    EXPECT_FALSE(ring.tryPush(extra));
+    for (int i = 0; i < 4; ++i) {
+        int value = -1;
+        ASSERT_TRUE(ring.tryPop(value));
+        EXPECT_EQ(value, i);
+    }
+    int value = -1;
+    EXPECT_FALSE(ring.tryPop(value));
+}
+
+TEST(BoundedRing, PopUntilReportsTimeoutAndClose) {
+    BoundedRing<int> ring(4);
+    int value = -1;
+    EXPECT_EQ(ring.popUntil(value, chrono::steady_clock::now() + chrono::milliseconds(5)), PopStatus::Timeout);
+    EXPECT_TRUE(ring.push(7));
+    ring.close();
+    EXPECT_FALSE(ring.push(8));
+    EXPECT_EQ(ring.popUntil(value, chrono::steady_clock::time_point::max()), PopStatus::Value);
+    EXPECT_EQ(value, 7);
+    EXPECT_EQ(ring.popUntil(value, chrono::steady_clock::time_point::max()), PopStatus::Closed);
+    EXPECT_FALSE(ring.pop(value));
+}
+
+TEST(BoundedRing, DeliversEveryValueOnceAcrossThreads) {
+    constexpr int kProducers = 4;
+    constexpr int kConsumers = 4;
+    constexpr int kPerProducer = 50000;
+    BoundedRing<int> ring(64);
+    vector<atomic<int>> seen(kProducers * kPerProducer);
+
+    vector<thread> consumers;
+    for (int c = 0; c < kConsumers; ++c) {
+        consumers.emplace_back([&] {
+            int value = 0;
+            while (ring.pop(value)) {
+                seen[value].fetch_add(1, memory_order_relaxed);
+            }
+        });
+    }
+    vector<thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p] {
+            for (int i = 0; i < kPerProducer; ++i) {
+                ring.push(p * kPerProducer + i);
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    ring.close();
+    for (auto& t : consumers) {
+        t.join();
+    }
+    EXPECT_TRUE(all_of(seen.begin(), seen.end(), [](const atomic<int>& count) { return count.load() == 1; }));
+}
+
+TEST(SpoolCodec, Crc32) {
+    string_view check = "123456789";
+    EXPECT_EQ(crc32(check.data(), check.size()), 0xCBF43926u);
+    EXPECT_EQ(crc32(nullptr, 0), 0u);
+    uint32_t partial = crc32(check.data(), 4);
+    EXPECT_EQ(crc32(check.data() + 4, check.size() - 4, partial), 0xCBF43926u);
+}
+
+TEST(SpoolCodec, RecordRoundTrip) {
+    TblCol columns = {{"datetime", "DateTime64(3)"}, {"id", "UInt32"}, {"host", "Nullable(String)"},
+                      {"src", "Nullable(IPv4)"}, {"dst", "Nullable(IPv6)"}};
+    vector<vector<string>> rows = {
+        {"2024-04-01 00:00:00.123Z", "1", "web-1", "10.0.0.1", "2001:db8::1"},
+        {"2024-04-01 00:00:01.000Z", "4294967295", "", "", "::ffff:1.2.3.4"},
+        {"1969-12-31 23:59:59.999Z", "0", "a\nb,\"c\"", "255.255.255.255", ""},
+    };
+    BlockBuilder builder(columns);
+    for (const auto& row : rows) {
+        builder.appendRow(row);
+    }
+    Batch batch = builder.build();
+
+    string record;
+    encodeSpoolRecord("t_test", "token-1", columns, batch.block, record);
+    string table_name;
+    string token;
+    vector<vector<string>> decoded;
+    ASSERT_TRUE(decodeSpoolRecord(record, table_name, token, [&](const vector<string_view>& values) {
+        decoded.emplace_back(values.begin(), values.end());
+    }));
+    EXPECT_EQ(table_name, "t_test");
+    EXPECT_EQ(token, "token-1");
+    // NULL возвращается пустым значением, как и было на входе
+    EXPECT_EQ(decoded, rows);
+
+    // Обрезанная на любом байте запись не разбирается
+    for (size_t size = 0; size < record.size(); ++size) {
+        size_t calls = 0;
+        EXPECT_FALSE(decodeSpoolRecord(string_view(record).substr(0, size), table_name, token,
+                                       [&](const vector<string_view>&) { ++calls; })) << size;
+    }
+}
+
+TEST(SpoolCodec, SegmentFraming) {
+    filesystem::path directory = filesystem::temp_directory_path() / ("spool-test-" + to_string(getpid()));
+    filesystem::remove_all(directory);
+    TblCol columns = {{"datetime", "DateTime64(3)"}, {"id", "UInt32"}};
+    {
+        Spool spool(directory);
+        BlockBuilder builder(columns);
+        builder.appendRow(vector<string>{"2024-04-01 00:00:00Z", "42"});
+        spool.append("t_test", "token-2", columns, builder.build().block);
+        spool.roll();
+        vector<filesystem::path> segments = spool.closedSegments();
+        ASSERT_EQ(segments.size(), 1u);
+
+        ifstream file(segments[0], ios::binary);
+        string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        ASSERT_GE(data.size(), sizeof(SpoolRecordHeader));
+        SpoolRecordHeader header;
+        memcpy(&header, data.data(), sizeof(header));
+        EXPECT_EQ(header.magic, SpoolRecordHeader::kMagic);
+        ASSERT_EQ(header.length, data.size() - sizeof(header));
+        string_view body = string_view(data).substr(sizeof(header));
+        EXPECT_EQ(crc32(body.data(), body.size()), header.crc);
+
+        string table_name;
+        string token;
+        vector<string> values;
+        ASSERT_TRUE(decodeSpoolRecord(body, table_name, token, [&](const vector<string_view>& row) {
+            values.assign(row.begin(), row.end());
+        }));
+        EXPECT_EQ(token, "token-2");
+        EXPECT_EQ(values, (vector<string>{"2024-04-01 00:00:00.000Z", "42"}));
+    }
+    filesystem::remove_all(directory);
+}
@@ -0,0 +1,249 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <signal.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Включается параметром --trace; выключенный span стоит одну проверку флага
+inline atomic<bool> tracingEnabled{false};
+
+// Запрос выгрузки трассы по SIGUSR1
+inline atomic<bool> traceDumpRequested{false};
+
+inline void requestTraceDump(int) {
+    traceDumpRequested.store(true);
+}
+
+// Завершённый интервал: имя — строковый литерал, подробность (обычно таблица) обрезается до 31 символа
+struct TraceEvent {
+    const char* name;
+    int64_t start;
+    int64_t duration;
+    uint64_t count;
+    char detail[32];
+};
+
+// Кольцо последних событий потока. Пишет только владелец; читатель копирует кольцо целиком
+// и отбрасывает события, которые могли быть перезаписаны во время копирования
+struct TraceRing {
+    static constexpr size_t kCapacity = 4096;
+
+    uint32_t thread = 0;
+    atomic<uint64_t> head{0};
+    array<TraceEvent, kCapacity> events{};
+
+    void push(const TraceEvent& event) {
+        uint64_t position = head.load(memory_order_relaxed);
+        events[position % kCapacity] = event;
+        head.store(position + 1, memory_order_release);
+    }
+};
+
+// Реестр колец: кольцо завершившегося потока с его событиями переходит следующему новому потоку
+class Tracer {
+public:
+    static Tracer& instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    // Наносекунды от запуска процесса
+    int64_t now() const {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch_).count();
+    }
+
+    TraceRing& local() {
+        thread_local Handle handle;
+        if (!handle.ring) {
+            handle.ring = acquire();
+        }
+        return *handle.ring;
+    }
+
+    // Трасса в формате Chrome trace-event JSON (открывается в Perfetto и chrome://tracing)
+    string json() {
+        string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        char line[256];
+        lock_guard<mutex> lock(mutex_);
+        for (const auto& ring : rings_) {
+            uint64_t before = ring->head.load(memory_order_acquire);
+            vector<TraceEvent> events(ring->events.begin(), ring->events.end());
+            atomic_thread_fence(memory_order_acquire);
+            uint64_t after = ring->head.load(memory_order_relaxed);
+            // Надёжны позиции, которые не могли быть перезаписаны до окончания копирования
+            uint64_t begin = after > TraceRing::kCapacity ? after - TraceRing::kCapacity + 1 : 0;
+            for (uint64_t position = begin; position < before; ++position) {
+                const TraceEvent& event = events[position % TraceRing::kCapacity];
+                int length = snprintf(line, sizeof(line),
+                                      "%s{\"name\":\"%s\",\"cat\":\"ingest\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                                      "\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+                                      first ? "" : ",\n", event.name, ring->thread, event.start / 1e3,
+                                      event.duration / 1e3);
+                out.append(line, static_cast<size_t>(min<int>(length, sizeof(line) - 1)));
+                first = false;
+                bool hasArgs = false;
+                if (event.detail[0]) {
+                    out += "\"detail\":\"";
+                    for (const char* c = event.detail; *c && c < event.detail + sizeof(event.detail); ++c) {
+                        if (*c == '"' || *c == '\\') {
+                            out += '\\';
+                        }
+                        out += static_cast<unsigned char>(*c) < 0x20 ? '?' : *c;
+                    }
+                    out += '"';
+                    hasArgs = true;
+                }
+                if (event.count) {
+                    out += hasArgs ? ",\"rows\":" : "\"rows\":";
+                    out += to_string(event.count);
+                }
+                out += "}}";
+            }
+        }
+        out += "\n]}\n";
+        return out;
+    }
+
+private:
+    struct Handle {
+        TraceRing* ring = nullptr;
+
+        ~Handle() {
+            if (ring) {
+                Tracer::instance().release(ring);
+            }
+        }
+    };
+
+    TraceRing* acquire() {
+        lock_guard<mutex> lock(mutex_);
+        if (!free_.empty()) {
+            TraceRing* ring = free_.back();
+            free_.pop_back();
+            return ring;
+        }
+        rings_.push_back(make_unique<TraceRing>());
+        rings_.back()->thread = static_cast<uint32_t>(rings_.size());
+        return rings_.back().get();
+    }
+
+    void release(TraceRing* ring) {
+        lock_guard<mutex> lock(mutex_);
+        free_.push_back(ring);
+    }
+
+    chrono::steady_clock::time_point epoch_ = chrono::steady_clock::now();
+    mutex mutex_;
+    vector<unique_ptr<TraceRing>> rings_;
+    vector<TraceRing*> free_;
+};
+
+// Интервал от создания до разрушения объекта: TraceSpan span("insert", table_name)
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, string_view detail = {}, uint64_t count = 0)
+        : enabled_(tracingEnabled.load(memory_order_relaxed)) {
+        if (!enabled_) {
+            return;
+        }
+        event_.name = name;
+        event_.count = count;
+        size_t length = min(detail.size(), sizeof(event_.detail) - 1);
+        memcpy(event_.detail, detail.data(), length);
+        event_.detail[length] = '\0';
+        event_.start = Tracer::instance().now();
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    ~TraceSpan() {
+        if (enabled_) {
+            Tracer& tracer = Tracer::instance();
+            event_.duration = tracer.now() - event_.start;
+            tracer.local().push(event_);
+        }
+    }
+
+    void setCount(uint64_t count) {
+        event_.count = count;
+    }
+
+private:
+    bool enabled_;
+    TraceEvent event_{};
+};
+
+// Выгрузка трассы в файл: по SIGUSR1 во время работы и при завершении. Файл заменяется
+// через переименование, поэтому читатель не увидит его недописанным
+class TraceDumper {
+public:
+    explicit TraceDumper(string path) : path_(move(path)) {
+        tracingEnabled = true;
+        struct sigaction action = {};
+        action.sa_handler = requestTraceDump;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGUSR1, &action, nullptr);
+        worker_ = thread([this] { run(); });
+    }
+
+    TraceDumper(const TraceDumper&) = delete;
+    TraceDumper& operator=(const TraceDumper&) = delete;
+
+    ~TraceDumper() {
+        stopping_ = true;
+        worker_.join();
+        dump();
+    }
+
+private:
+    void run() {
+        while (!stopping_) {
+            this_thread::sleep_for(chrono::milliseconds(200));
+            if (traceDumpRequested.exchange(false)) {
+                dump();
+            }
+        }
+    }
+
+    void dump() {
+        string temporary = path_ + ".tmp";
+        {
+            ofstream file(temporary, ios::binary | ios::trunc);
+            file << Tracer::instance().json();
+            if (!file) {
+                cerr << "Предупреждение: не удалось записать трассу в " << temporary << endl;
+                return;
+            }
+        }
+        if (::rename(temporary.c_str(), path_.c_str()) != 0) {
+            cerr << "Предупреждение: не удалось заменить файл трассы " << path_ << endl;
+            return;
+        }
+        cerr << "Трасса записана в " << path_ << endl;
+    }
+
+    string path_;
+    atomic<bool> stopping_{false};
+    thread worker_;
+};
+
+#endif // TRACE_H
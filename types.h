@@ -0,0 +1,188 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "schemas.h"
+
+using namespace std;
+
+// Базовый тип столбца без обёрток Nullable/LowCardinality
+enum class BaseType : uint8_t {
+    Unknown,
+    UInt8,
+    UInt16,
+    UInt32,
+    UInt64,
+    String,
+    IPv4,
+    IPv6,
+    DateTime64,
+};
+
+inline constexpr size_t kBaseTypeCount = static_cast<size_t>(BaseType::DateTime64) + 1;
+
+// Разобранный тип столбца ClickHouse
+struct TypeDesc {
+    BaseType base = BaseType::Unknown;
+    bool nullable = false;
+    bool lowCardinality = false;
+    uint8_t precision = 0;
+    // Часовой пояс DateTime64(P, 'tz'); указывает в строку типа, из которой разобран дескриптор
+    string_view timezone;
+
+    bool operator==(const TypeDesc&) const = default;
+};
+
+using TypeId = uint16_t;
+
+constexpr bool unwrapType(string_view& type, string_view wrapper) {
+    if (type.size() > wrapper.size() + 2 && type.starts_with(wrapper) && type[wrapper.size()] == '(' &&
+        type.back() == ')') {
+        type = type.substr(wrapper.size() + 1, type.size() - wrapper.size() - 2);
+        return true;
+    }
+    return false;
+}
+
+// Аргументы DateTime64: точность целиком ("12" — это 12, а не 1) и необязательный часовой пояс в кавычках.
+// Неразобранные аргументы оставляют тип неизвестным
+constexpr void parseDateTime64Args(string_view args, TypeDesc& desc) {
+    size_t pos = 0;
+    unsigned precision = 0;
+    while (pos < args.size() && args[pos] >= '0' && args[pos] <= '9' && precision <= 255) {
+        precision = precision * 10 + static_cast<unsigned>(args[pos++] - '0');
+    }
+    if (pos == 0 || precision > 255) {
+        return;
+    }
+    string_view timezone;
+    if (pos < args.size()) {
+        if (args[pos++] != ',') {
+            return;
+        }
+        while (pos < args.size() && args[pos] == ' ') {
+            ++pos;
+        }
+        if (args.size() - pos < 2 || args[pos] != '\'' || args.back() != '\'') {
+            return;
+        }
+        timezone = args.substr(pos + 1, args.size() - pos - 2);
+        if (timezone.empty() || timezone.find('\'') != string_view::npos) {
+            return;
+        }
+    }
+    desc.base = BaseType::DateTime64;
+    desc.precision = static_cast<uint8_t>(precision);
+    desc.timezone = timezone;
+}
+
+// Разбор строки типа ClickHouse, например "LowCardinality(Nullable(String))" или "DateTime64(3, 'UTC')"
+constexpr TypeDesc parseType(string_view type) {
+    TypeDesc desc;
+    desc.lowCardinality = unwrapType(type, "LowCardinality");
+    desc.nullable = unwrapType(type, "Nullable");
+
+    if (type == "UInt8") {
+        desc.base = BaseType::UInt8;
+    } else if (type == "UInt16") {
+        desc.base = BaseType::UInt16;
+    } else if (type == "UInt32") {
+        desc.base = BaseType::UInt32;
+    } else if (type == "UInt64") {
+        desc.base = BaseType::UInt64;
+    } else if (type == "String") {
+        desc.base = BaseType::String;
+    } else if (type == "IPv4") {
+        desc.base = BaseType::IPv4;
+    } else if (type == "IPv6") {
+        desc.base = BaseType::IPv6;
+    } else if (unwrapType(type, "DateTime64")) {
+        parseDateTime64Args(type, desc);
+    }
+    return desc;
+}
+
+// Таблица интернированных дескрипторов: одинаковые типы получают один и тот же TypeId.
+// Типы эталонных схем регистрируются первыми, поэтому TypeId совпадает со значением ChType.
+class TypeRegistry {
+public:
+    static constexpr size_t kCapacity = 256;
+
+    static TypeRegistry& instance() {
+        static TypeRegistry registry;
+        return registry;
+    }
+
+    TypeId intern(string_view type) {
+        lock_guard<mutex> lock(mutex_);
+        auto byName = byName_.find(type);
+        if (byName != byName_.end()) {
+            return byName->second;
+        }
+
+        TypeDesc desc = parseType(type);
+        size_t count = count_.load(memory_order_relaxed);
+        TypeId id = static_cast<TypeId>(count);
+        // Неизвестные типы не объединяются: у каждого остаётся своё имя
+        for (size_t i = 0; i < count && desc.base != BaseType::Unknown; ++i) {
+            if (descs_[i] == desc) {
+                id = static_cast<TypeId>(i);
+                break;
+            }
+        }
+        if (id == count) {
+            if (count == kCapacity) {
+                throw length_error("Слишком много различных типов столбцов");
+            }
+            names_[count] = string(type);
+            // Повторный разбор, чтобы часовой пояс ссылался на строку, которой владеет таблица
+            descs_[count] = parseType(names_[count]);
+            count_.store(count + 1, memory_order_release);
+        }
+        byName_.emplace(string(type), id);
+        return id;
+    }
+
+    // Дескриптор по идентификатору; чтение не требует блокировки
+    const TypeDesc& desc(TypeId id) const {
+        return descs_[id];
+    }
+
+    const string& name(TypeId id) const {
+        return names_[id];
+    }
+
+private:
+    TypeRegistry() {
+        for (size_t i = 0; i <= static_cast<size_t>(ChType::NullableDateTime64_3); ++i) {
+            intern(typeName(static_cast<ChType>(i)));
+        }
+    }
+
+    mutex mutex_;
+    map<string, TypeId, less<>> byName_;
+    array<TypeDesc, kCapacity> descs_{};
+    array<string, kCapacity> names_{};
+    atomic<size_t> count_{0};
+};
+
+inline TypeId internType(string_view type) {
+    return TypeRegistry::instance().intern(type);
+}
+
+inline const TypeDesc& typeDesc(TypeId id) {
+    return TypeRegistry::instance().desc(id);
+}
+
+constexpr TypeId typeId(ChType type) {
+    return static_cast<TypeId>(type);
+}
+
+#endif // TYPES_H